@@ -3,7 +3,9 @@
 #include <string.h>
 #include <stdio.h>
 #include "devices/ide.h"
+#include "devices/timer.h"
 #include "threads/malloc.h"
+#include "threads/synch.h"
 
 /* A block device. */
 struct block
@@ -120,9 +122,7 @@ check_sector (struct block *block, block_sector_t sector)
 void
 block_read (struct block *block, block_sector_t sector, void *buffer)
 {
-  check_sector (block, sector);
-  block->ops->read (block->aux, sector, buffer);
-  block->read_cnt++;
+  block_readv (block, sector, 1, &buffer);
 }
 
 /* Write sector SECTOR to BLOCK from BUFFER, which must contain
@@ -133,10 +133,374 @@ block_read (struct block *block, block_sector_t sector, void *buffer)
 void
 block_write (struct block *block, block_sector_t sector, const void *buffer)
 {
+  block_writev (block, sector, 1, &buffer);
+}
+
+/* Verifies that the CNT sectors starting at SECTOR all lie
+   within BLOCK.  Panics if not. */
+static void
+check_sectors (struct block *block, block_sector_t sector,
+               block_sector_t cnt)
+{
+  ASSERT (cnt > 0);
   check_sector (block, sector);
-  ASSERT (block->type != BLOCK_FOREIGN);
-  block->ops->write (block->aux, sector, buffer);
-  block->write_cnt++;
+  if (sector + cnt < sector)
+    PANIC ("Sector range wraps on device %s (sector=%"PRDSNu", "
+           "count=%"PRDSNu")\n", block_name (block), sector, cnt);
+  check_sector (block, sector + cnt - 1);
+}
+
+/* Completion function for block_wait(). */
+static void
+wake_waiter (struct block_request *r UNUSED, void *done)
+{
+  sema_up (done);
+}
+
+/* Submits R to BLOCK and waits for it to complete.  Fills in R's
+   COMPLETE and AUX members. */
+static void
+block_wait (struct block *block, struct block_request *r)
+{
+  struct semaphore done;
+
+  sema_init (&done, 0);
+  r->complete = wake_waiter;
+  r->aux = &done;
+  block_submit (block, r);
+  sema_down (&done);
+}
+
+/* Carries out R on BLOCK, whose driver does not implement
+   SUBMIT, by calling the driver's synchronous operations. */
+static void
+transfer_sync (struct block *block, struct block_request *r)
+{
+  if (!r->write)
+    {
+      if (block->ops->readv != NULL)
+        block->ops->readv (block->aux, r->sector, r->cnt, r->buffers);
+      else
+        {
+          block_sector_t i;
+
+          for (i = 0; i < r->cnt; i++)
+            block->ops->read (block->aux, r->sector + i, r->buffers[i]);
+        }
+    }
+  else
+    {
+      const void *const *buffers = (const void *const *) r->buffers;
+
+      if (block->ops->writev != NULL)
+        block->ops->writev (block->aux, r->sector, r->cnt, buffers);
+      else
+        {
+          block_sector_t i;
+
+          for (i = 0; i < r->cnt; i++)
+            block->ops->write (block->aux, r->sector + i, buffers[i]);
+        }
+    }
+}
+
+/* Reads the CNT consecutive sectors starting at SECTOR from
+   BLOCK into BUFFERS[0] through BUFFERS[CNT - 1], each of which
+   must have room for BLOCK_SECTOR_SIZE bytes.  Drivers that
+   support it transfer the whole run with a single command;
+   others fall back to reading one sector at a time. */
+void
+block_readv (struct block *block, block_sector_t sector, block_sector_t cnt,
+             void *const buffers[])
+{
+  struct block_request r;
+
+  r.sector = sector;
+  r.cnt = cnt;
+  r.buffers = buffers;
+  r.write = false;
+  block_wait (block, &r);
+}
+
+/* Writes the CNT consecutive sectors starting at SECTOR to BLOCK
+   from BUFFERS[0] through BUFFERS[CNT - 1], each of which must
+   contain BLOCK_SECTOR_SIZE bytes.  Returns after the block
+   device has acknowledged receiving all of the data. */
+void
+block_writev (struct block *block, block_sector_t sector, block_sector_t cnt,
+              const void *const buffers[])
+{
+  struct block_request r;
+
+  r.sector = sector;
+  r.cnt = cnt;
+  r.buffers = (void *const *) buffers;
+  r.write = true;
+  block_wait (block, &r);
+}
+
+/* Starts the transfer described by R on BLOCK and returns,
+   usually before the transfer completes.  R's COMPLETE function
+   is called when it does.  Drivers that cannot transfer
+   asynchronously complete R before returning. */
+void
+block_submit (struct block *block, struct block_request *r)
+{
+  check_sectors (block, r->sector, r->cnt);
+  if (r->write)
+    {
+      ASSERT (block->type != BLOCK_FOREIGN);
+      block->write_cnt += r->cnt;
+    }
+  else
+    block->read_cnt += r->cnt;
+
+  if (block->ops->submit != NULL)
+    block->ops->submit (block->aux, r);
+  else
+    {
+      transfer_sync (block, r);
+      r->next = NULL;
+      block_request_done (r);
+    }
+}
+
+/* Calls the completion function of R and of each request merged
+   with it.  Called by drivers when a transfer finishes, possibly
+   within an interrupt handler. */
+void
+block_request_done (struct block_request *r)
+{
+  while (r != NULL)
+    {
+      /* The completion function may free R. */
+      struct block_request *next = r->next;
+      r->complete (r, r->aux);
+      r = next;
+    }
+}
+
+/* Request queues and elevators. */
+
+/* How long, in timer ticks, the deadline elevator lets a read or
+   a write wait before dispatching it ahead of requests that are
+   nearer the disk head.  Reads usually have a thread blocked on
+   them, so they get the shorter deadline. */
+#define READ_EXPIRE (TIMER_FREQ / 2)
+#define WRITE_EXPIRE (TIMER_FREQ * 5)
+
+/* An elevator, a policy for choosing the next request to
+   dispatch from a nonempty queue. */
+struct elevator
+  {
+    const char *name;
+    struct block_request *(*choose) (struct block_queue *);
+  };
+
+/* First come, first served. */
+static struct block_request *
+fifo_choose (struct block_queue *q)
+{
+  return list_entry (list_front (&q->requests), struct block_request, elem);
+}
+
+/* Circular LOOK: the request with the lowest sector at or above
+   the head position, or if there is none, the request with the
+   lowest sector overall, so that the head sweeps in one
+   direction and then returns to the start. */
+static struct block_request *
+clook_choose (struct block_queue *q)
+{
+  struct block_request *ahead = NULL, *lowest = NULL;
+  struct list_elem *e;
+
+  for (e = list_begin (&q->requests); e != list_end (&q->requests);
+       e = list_next (e))
+    {
+      struct block_request *r = list_entry (e, struct block_request, elem);
+      if (r->sector >= q->head && (ahead == NULL || r->sector < ahead->sector))
+        ahead = r;
+      if (lowest == NULL || r->sector < lowest->sector)
+        lowest = r;
+    }
+  return ahead != NULL ? ahead : lowest;
+}
+
+/* C-LOOK, except that a request whose deadline has passed is
+   dispatched first, earliest deadline first, so that a stream of
+   nearby requests cannot starve a distant one. */
+static struct block_request *
+deadline_choose (struct block_queue *q)
+{
+  int64_t now = timer_ticks ();
+  struct block_request *expired = NULL;
+  struct list_elem *e;
+
+  for (e = list_begin (&q->requests); e != list_end (&q->requests);
+       e = list_next (e))
+    {
+      struct block_request *r = list_entry (e, struct block_request, elem);
+      if (r->deadline <= now
+          && (expired == NULL || r->deadline < expired->deadline))
+        expired = r;
+    }
+  return expired != NULL ? expired : clook_choose (q);
+}
+
+/* Available elevators.  The first is the default. */
+static const struct elevator elevators[] =
+  {
+    {"deadline", deadline_choose},
+    {"clook", clook_choose},
+    {"fifo", fifo_choose},
+  };
+#define ELEVATOR_CNT (sizeof elevators / sizeof *elevators)
+
+/* Elevator used by all queues. */
+static const struct elevator *elevator = &elevators[0];
+
+/* Makes the elevator with the given NAME the one used by all
+   block queues.  Returns true if successful, false if there is
+   no elevator with that name. */
+bool
+block_set_elevator (const char *name)
+{
+  size_t i;
+
+  for (i = 0; i < ELEVATOR_CNT; i++)
+    if (!strcmp (name, elevators[i].name))
+      {
+        elevator = &elevators[i];
+        return true;
+      }
+  return false;
+}
+
+/* Initializes Q as an empty queue. */
+void
+block_queue_init (struct block_queue *q)
+{
+  list_init (&q->requests);
+  q->head = 0;
+}
+
+/* Returns true if Q has no pending requests. */
+bool
+block_queue_empty (struct block_queue *q)
+{
+  return list_empty (&q->requests);
+}
+
+/* Adds R to Q. */
+void
+block_queue_push (struct block_queue *q, struct block_request *r)
+{
+  r->deadline = timer_ticks () + (r->write ? WRITE_EXPIRE : READ_EXPIRE);
+  list_push_back (&q->requests, &r->elem);
+}
+
+/* Returns the request in Q that continues where R leaves off,
+   in the same direction, or a null pointer if there is none. */
+static struct block_request *
+find_adjacent (struct block_queue *q, const struct block_request *r)
+{
+  struct list_elem *e;
+
+  for (e = list_begin (&q->requests); e != list_end (&q->requests);
+       e = list_next (e))
+    {
+      struct block_request *s = list_entry (e, struct block_request, elem);
+      if (s->write == r->write && s->sector == r->sector + r->cnt)
+        return s;
+    }
+  return NULL;
+}
+
+/* Removes the request that the current elevator chooses from Q,
+   together with any further requests that continue it, in
+   sector order, for as long as the run stays within MAX_CNT
+   sectors.  The requests are chained through their NEXT
+   members, so that a driver can carry out the whole run as one
+   transfer and then pass the first one to block_request_done().
+   Returns a null pointer if Q is empty. */
+struct block_request *
+block_queue_pop (struct block_queue *q, block_sector_t max_cnt)
+{
+  struct block_request *first, *last, *r;
+  block_sector_t cnt;
+
+  if (list_empty (&q->requests))
+    return NULL;
+
+  first = last = elevator->choose (q);
+  list_remove (&first->elem);
+  cnt = first->cnt;
+  while ((r = find_adjacent (q, last)) != NULL && cnt + r->cnt <= max_cnt)
+    {
+      list_remove (&r->elem);
+      last->next = r;
+      last = r;
+      cnt += r->cnt;
+    }
+  last->next = NULL;
+
+  q->head = last->sector + last->cnt;
+  return first;
+}
+
+/* Maximum number of sectors that block_read_multi() and
+   block_write_multi() hand to the driver at once.  Bounds the
+   size of the buffer array built on the kernel stack. */
+#define BLOCK_MULTI_MAX 32
+
+/* Reads the CNT consecutive sectors starting at SECTOR from
+   BLOCK into BUFFER, which must have room for
+   CNT * BLOCK_SECTOR_SIZE bytes. */
+void
+block_read_multi (struct block *block, block_sector_t sector,
+                  block_sector_t cnt, void *buffer)
+{
+  uint8_t *p = buffer;
+
+  while (cnt > 0)
+    {
+      void *buffers[BLOCK_MULTI_MAX];
+      block_sector_t chunk = cnt < BLOCK_MULTI_MAX ? cnt : BLOCK_MULTI_MAX;
+      block_sector_t i;
+
+      for (i = 0; i < chunk; i++)
+        buffers[i] = p + i * BLOCK_SECTOR_SIZE;
+      block_readv (block, sector, chunk, buffers);
+
+      sector += chunk;
+      cnt -= chunk;
+      p += chunk * BLOCK_SECTOR_SIZE;
+    }
+}
+
+/* Writes the CNT consecutive sectors starting at SECTOR to BLOCK
+   from BUFFER, which must contain CNT * BLOCK_SECTOR_SIZE
+   bytes. */
+void
+block_write_multi (struct block *block, block_sector_t sector,
+                   block_sector_t cnt, const void *buffer)
+{
+  const uint8_t *p = buffer;
+
+  while (cnt > 0)
+    {
+      const void *buffers[BLOCK_MULTI_MAX];
+      block_sector_t chunk = cnt < BLOCK_MULTI_MAX ? cnt : BLOCK_MULTI_MAX;
+      block_sector_t i;
+
+      for (i = 0; i < chunk; i++)
+        buffers[i] = p + i * BLOCK_SECTOR_SIZE;
+      block_writev (block, sector, chunk, buffers);
+
+      sector += chunk;
+      cnt -= chunk;
+      p += chunk * BLOCK_SECTOR_SIZE;
+    }
 }
 
 /* Returns the number of sectors in BLOCK. */
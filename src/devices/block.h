@@ -3,6 +3,8 @@
 
 #include <stddef.h>
 #include <inttypes.h>
+#include <list.h>
+#include <stdbool.h>
 
 /* Size of a block device sector in bytes.
    All IDE disks use this sector size, as do most USB and SCSI
@@ -53,20 +55,95 @@ struct block *block_next (struct block *);
 block_sector_t block_size (struct block *);
 void block_read (struct block *, block_sector_t, void *);
 void block_write (struct block *, block_sector_t, const void *);
+void block_read_multi (struct block *, block_sector_t, block_sector_t cnt,
+                       void *);
+void block_write_multi (struct block *, block_sector_t, block_sector_t cnt,
+                        const void *);
+void block_readv (struct block *, block_sector_t, block_sector_t cnt,
+                  void *const buffers[]);
+void block_writev (struct block *, block_sector_t, block_sector_t cnt,
+                   const void *const buffers[]);
 const char *block_name (struct block *);
 enum block_type block_type (struct block *);
 
+/* An asynchronous transfer of CNT consecutive sectors starting
+   at SECTOR, between the device and BUFFERS[0] through
+   BUFFERS[CNT - 1], each of which holds BLOCK_SECTOR_SIZE bytes.
+
+   The caller fills in the first six members and passes the
+   request to block_submit(), which returns at once.  When the
+   transfer finishes, the block layer calls COMPLETE, passing it
+   the request and AUX.  COMPLETE may be called in an interrupt
+   handler, so it must not sleep.  Until then the request belongs
+   to the block layer, which may change any of its members
+   except BUFFERS, COMPLETE, and AUX. */
+struct block_request
+  {
+    block_sector_t sector;              /* First sector. */
+    block_sector_t cnt;                 /* Number of sectors. */
+    void *const *buffers;               /* CNT sector buffers. */
+    bool write;                         /* True to write, false to read. */
+    void (*complete) (struct block_request *, void *aux);
+    void *aux;                          /* Passed to COMPLETE. */
+
+    /* Owned by the block layer. */
+    struct list_elem elem;              /* Element in a block_queue. */
+    int64_t deadline;                   /* Timer tick to dispatch by. */
+    struct block_request *next;         /* Next request in a merged run. */
+  };
+
+void block_submit (struct block *, struct block_request *);
+
+/* Selecting the elevator that orders each device's queue. */
+bool block_set_elevator (const char *name);
+
 /* Statistics. */
 void block_print_stats (void);
 
 /* Lower-level interface to block device drivers. */
 
+/* READ and WRITE transfer a single sector.  READV and WRITEV,
+   which a driver may leave null, transfer CNT consecutive
+   sectors starting at the given sector, scattering them into or
+   gathering them from BUFFERS[0] through BUFFERS[CNT - 1], each
+   of which holds BLOCK_SECTOR_SIZE bytes.
+
+   SUBMIT, which a driver may also leave null, starts the
+   transfer described by a block_request and returns without
+   waiting for it, calling block_request_done() when it
+   finishes.  A driver that provides SUBMIT may leave the other
+   operations null, since the block layer then implements them
+   in terms of SUBMIT. */
 struct block_operations
   {
     void (*read) (void *aux, block_sector_t, void *buffer);
     void (*write) (void *aux, block_sector_t, const void *buffer);
+    void (*readv) (void *aux, block_sector_t, block_sector_t cnt,
+                   void *const buffers[]);
+    void (*writev) (void *aux, block_sector_t, block_sector_t cnt,
+                    const void *const buffers[]);
+    void (*submit) (void *aux, struct block_request *);
   };
 
+/* A queue of pending requests for a driver that implements
+   SUBMIT.  The driver adds requests with block_queue_push() and
+   takes them, in the order chosen by the current elevator and
+   with adjacent requests merged, with block_queue_pop().  The
+   driver must synchronize access to the queue itself, typically
+   by disabling interrupts. */
+struct block_queue
+  {
+    struct list requests;               /* Pending block_requests. */
+    block_sector_t head;                /* Sector after the last one popped. */
+  };
+
+void block_queue_init (struct block_queue *);
+bool block_queue_empty (struct block_queue *);
+void block_queue_push (struct block_queue *, struct block_request *);
+struct block_request *block_queue_pop (struct block_queue *,
+                                       block_sector_t max_cnt);
+void block_request_done (struct block_request *);
+
 struct block *block_register (const char *name, enum block_type,
                               const char *extra_info, block_sector_t size,
                               const struct block_operations *, void *aux);
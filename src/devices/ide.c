@@ -1,14 +1,20 @@
 #include "devices/ide.h"
 #include <ctype.h>
 #include <debug.h>
+#include <packed.h>
 #include <stdbool.h>
 #include <stdio.h>
+#include <string.h>
 #include "devices/block.h"
 #include "devices/partition.h"
+#include "devices/pci.h"
 #include "devices/timer.h"
 #include "threads/io.h"
 #include "threads/interrupt.h"
+#include "threads/palloc.h"
 #include "threads/synch.h"
+#include "threads/thread.h"
+#include "threads/vaddr.h"
 
 /* The code in this file is an interface to an ATA (IDE)
    controller.  It attempts to comply to [ATA-3]. */
@@ -34,6 +40,7 @@
 #define STA_BSY 0x80            /* Busy. */
 #define STA_DRDY 0x40           /* Device Ready. */
 #define STA_DRQ 0x08            /* Data Request. */
+#define STA_ERR 0x01            /* Error. */
 
 /* Control Register bits. */
 #define CTL_SRST 0x04           /* Software Reset. */
@@ -49,6 +56,44 @@
 #define CMD_IDENTIFY_DEVICE 0xec        /* IDENTIFY DEVICE. */
 #define CMD_READ_SECTOR_RETRY 0x20      /* READ SECTOR with retries. */
 #define CMD_WRITE_SECTOR_RETRY 0x30     /* WRITE SECTOR with retries. */
+#define CMD_READ_MULTIPLE 0xc4          /* READ MULTIPLE. */
+#define CMD_WRITE_MULTIPLE 0xc5         /* WRITE MULTIPLE. */
+#define CMD_SET_MULTIPLE_MODE 0xc6      /* SET MULTIPLE MODE. */
+#define CMD_READ_DMA 0xc8               /* READ DMA. */
+#define CMD_WRITE_DMA 0xca              /* WRITE DMA. */
+
+/* Bus-master IDE registers, relative to a channel's bus-master
+   base port.  See the PIIX datasheet, "Bus Master IDE I/O
+   Registers".  QEMU and Bochs emulate a PIIX-compatible
+   controller. */
+#define BM_COMMAND 0            /* Command. */
+#define BM_STATUS 2             /* Status. */
+#define BM_PRDT 4               /* Physical region descriptor table. */
+
+/* Bus-master command register bits. */
+#define BM_CMD_START 0x01       /* Start transfer. */
+#define BM_CMD_READ 0x08        /* 1=write to memory (disk read). */
+
+/* Bus-master status register bits. */
+#define BM_STA_ERR 0x02         /* Error (write 1 to clear). */
+#define BM_STA_IRQ 0x04         /* Interrupt (write 1 to clear). */
+
+/* A physical region descriptor: one physically contiguous piece
+   of a DMA transfer.  A region may not cross a 64 kB boundary. */
+struct prd
+  {
+    uint32_t addr;              /* Physical base address. */
+    uint16_t size;              /* Byte count, 0 means 64 kB. */
+    uint16_t flags;             /* PRD_EOT on the last entry. */
+  }
+PACKED;
+
+#define PRD_EOT 0x8000          /* End of table. */
+#define PRD_CNT (PGSIZE / sizeof (struct prd))  /* Entries per table. */
+
+/* Most sectors a single READ or WRITE command may transfer.
+   A sector count register value of 0 means 256. */
+#define MAX_SECTORS_PER_CMD 256
 
 /* An ATA device. */
 struct ata_disk
@@ -57,6 +102,10 @@ struct ata_disk
     struct channel *channel;    /* Channel that disk is attached to. */
     int dev_no;                 /* Device 0 or 1 for master or slave. */
     bool is_ata;                /* Is device an ATA disk? */
+    int multiple;               /* Sectors per DRQ block in READ/WRITE
+                                   MULTIPLE, or 1 if unsupported. */
+    bool dma;                   /* Does the disk support DMA? */
+    struct block_queue queue;   /* Requests waiting for the channel. */
   };
 
 /* An ATA channel (aka controller).
@@ -67,11 +116,25 @@ struct channel
     uint16_t reg_base;          /* Base I/O port. */
     uint8_t irq;                /* Interrupt in use. */
 
-    struct lock lock;           /* Must acquire to access the controller. */
     bool expecting_interrupt;   /* True if an interrupt is expected, false if
                                    any interrupt would be spurious. */
     struct semaphore completion_wait;   /* Up'd by interrupt handler. */
 
+    uint16_t bm_base;           /* Bus-master base port, 0 if none. */
+    struct prd *prdt;           /* Physical region descriptor table. */
+
+    struct semaphore work;      /* Up'd for each request queued. */
+    int next_dev;               /* Device to serve first. */
+
+    /* Transfer in progress.  Accessed only by the dispatcher. */
+    struct ata_disk *disk;      /* Disk being accessed. */
+    struct block_request *run;  /* Run of merged requests being done. */
+    struct block_request *req;  /* Request holding the next buffer. */
+    block_sector_t idx;         /* Index of the next buffer in REQ. */
+    block_sector_t sec_no;      /* Next sector to transfer. */
+    block_sector_t left;        /* Sectors left in the run. */
+    block_sector_t cmd_left;    /* Sectors left in the current command. */
+
     struct ata_disk devices[2];     /* The devices on this channel. */
   };
 
@@ -84,9 +147,12 @@ static struct block_operations ide_operations;
 static void reset_channel (struct channel *);
 static bool check_device_type (struct ata_disk *);
 static void identify_ata_device (struct ata_disk *);
+static void set_multiple_mode (struct ata_disk *, int sectors);
+static uint16_t find_bus_master (void);
 
-static void select_sector (struct ata_disk *, block_sector_t);
-static void issue_pio_command (struct channel *, uint8_t command);
+static void select_sector (struct ata_disk *, block_sector_t,
+                           block_sector_t cnt);
+static void issue_command (struct channel *, uint8_t command);
 static void input_sector (struct channel *, void *);
 static void output_sector (struct channel *, const void *);
 
@@ -96,11 +162,13 @@ static void select_device (const struct ata_disk *);
 static void select_device_wait (const struct ata_disk *);
 
 static void interrupt_handler (struct intr_frame *);
+static void dispatcher (void *channel);
 
 /* Initialize the disk subsystem and detect disks. */
 void
 ide_init (void) 
 {
+  uint16_t bm_base = find_bus_master ();
   size_t chan_no;
 
   for (chan_no = 0; chan_no < CHANNEL_CNT; chan_no++)
@@ -123,9 +191,22 @@ ide_init (void)
         default:
           NOT_REACHED ();
         }
-      lock_init (&c->lock);
       c->expecting_interrupt = false;
       sema_init (&c->completion_wait, 0);
+      sema_init (&c->work, 0);
+      c->next_dev = 0;
+
+      /* Set up bus-master DMA, if the controller supports it.
+         The secondary channel's registers follow the
+         primary's. */
+      c->bm_base = 0;
+      c->prdt = NULL;
+      if (bm_base != 0)
+        {
+          c->prdt = palloc_get_page (PAL_ZERO);
+          if (c->prdt != NULL)
+            c->bm_base = bm_base + chan_no * 8;
+        }
  
       /* Initialize devices. */
       for (dev_no = 0; dev_no < 2; dev_no++)
@@ -136,11 +217,18 @@ ide_init (void)
           d->channel = c;
           d->dev_no = dev_no;
           d->is_ata = false;
+          d->multiple = 1;
+          d->dma = false;
+          block_queue_init (&d->queue);
         }
 
       /* Register interrupt handler. */
       intr_register_ext (c->irq, interrupt_handler, c->name);
 
+      /* Start the thread that carries out the channel's
+         requests, so that the two channels work in parallel. */
+      thread_create (c->name, PRI_MAX, dispatcher, c);
+
       /* Reset hardware. */
       reset_channel (c);
 
@@ -272,7 +360,7 @@ identify_ata_device (struct ata_disk *d)
      indicating the device's response is ready, and read the data
      into our buffer. */
   select_device_wait (d);
-  issue_pio_command (c, CMD_IDENTIFY_DEVICE);
+  issue_command (c, CMD_IDENTIFY_DEVICE);
   sema_down (&c->completion_wait);
   if (!wait_while_busy (d))
     {
@@ -303,12 +391,81 @@ identify_ata_device (struct ata_disk *d)
       return;
     }
 
+  /* Enable READ/WRITE MULTIPLE with the largest DRQ block the
+     device supports, so that multi-sector transfers take one
+     interrupt per block instead of one per sector. */
+  set_multiple_mode (d, (uint8_t) id[47 * 2]);
+
+  /* Use DMA if both the disk (IDENTIFY word 49, bit 8) and the
+     channel support it. */
+  d->dma = c->bm_base != 0 && (*(uint16_t *) &id[49 * 2] & 0x0100) != 0;
+  if (d->dma)
+    snprintf (extra_info + strlen (extra_info),
+              sizeof extra_info - strlen (extra_info), ", DMA");
+
   /* Register. */
   block = block_register (d->name, BLOCK_RAW, extra_info, capacity,
                           &ide_operations, d);
   partition_scan (block);
 }
 
+/* Sends a SET MULTIPLE MODE command to disk D asking for
+   SECTORS sectors per DRQ block, and records the result in D's
+   multiple member.  Leaves D using single-sector blocks if
+   SECTORS is less than 2 or the disk rejects the command. */
+static void
+set_multiple_mode (struct ata_disk *d, int sectors)
+{
+  struct channel *c = d->channel;
+
+  d->multiple = 1;
+  if (sectors < 2)
+    return;
+
+  select_device_wait (d);
+  outb (reg_nsect (c), sectors);
+  issue_command (c, CMD_SET_MULTIPLE_MODE);
+  sema_down (&c->completion_wait);
+  wait_while_busy (d);
+  if ((inb (reg_status (c)) & STA_ERR) == 0)
+    d->multiple = sectors;
+}
+
+/* Looks for a PCI IDE controller that supports bus-master DMA
+   on the legacy channels that we drive, and enables it.  Returns
+   the controller's bus-master base I/O port, or 0 if there is
+   no usable controller. */
+static uint16_t
+find_bus_master (void)
+{
+  struct pci_device pci;
+  uint32_t command, bar;
+  uint8_t prog_if;
+
+  if (!pci_find_class (0x01, 0x01, &pci))
+    return 0;
+
+  /* Programming interface bit 7 means bus mastering is
+     supported.  Bits 0 and 2 mean the primary or secondary
+     channel is in native mode, at ports other than the legacy
+     ones used by this driver. */
+  prog_if = pci_read_config (&pci, PCI_REG_CLASS) >> 8;
+  if ((prog_if & 0x80) == 0 || (prog_if & 0x05) != 0)
+    return 0;
+
+  /* BAR 4 holds the bus-master registers, in I/O space. */
+  bar = pci_read_config (&pci, PCI_REG_BAR (4));
+  if ((bar & 1) == 0 || (bar & 0xfffc) == 0)
+    return 0;
+
+  /* Write back only the command half of the register, since
+     status bits are cleared by writing 1s to them. */
+  command = pci_read_config (&pci, PCI_REG_COMMAND) & 0xffff;
+  pci_write_config (&pci, PCI_REG_COMMAND,
+                    command | PCI_CMD_IO | PCI_CMD_MASTER);
+  return bar & 0xfffc;
+}
+
 /* Translates STRING, which consists of SIZE bytes in a funky
    format, into a null-terminated string in-place.  Drops
    trailing whitespace and null bytes.  Returns STRING.  */
@@ -337,63 +494,299 @@ descramble_ata_string (char *string, int size)
   return string;
 }
 
-/* Reads sector SEC_NO from disk D into BUFFER, which must have
-   room for BLOCK_SECTOR_SIZE bytes.
-   Internally synchronizes accesses to disks, so external
-   per-disk locking is unneeded. */
+/* Request processing.
+
+   Each disk has a queue of pending requests, and each channel
+   has a dispatcher thread.  The dispatcher takes the next run of
+   merged requests from one of its disks' queues, carries it out
+   with as few commands as possible, sleeping until each command
+   interrupts, and then completes the run's requests.  Because
+   each channel has its own dispatcher, disks on different
+   channels transfer data at the same time. */
+
+/* Returns the buffer for the next sector of channel C's current
+   run and advances past it. */
+static void *
+next_buffer (struct channel *c)
+{
+  void *buffer = c->req->buffers[c->idx];
+  if (++c->idx >= c->req->cnt)
+    {
+      c->req = c->req->next;
+      c->idx = 0;
+    }
+  return buffer;
+}
+
+/* Fills channel C's physical region descriptor table so that it
+   covers the next CMD_CNT buffers of C's current run, merging
+   physically adjacent buffers.  Returns false if some buffer
+   cannot be used for DMA, in which case the caller should fall
+   back to PIO. */
+static bool
+setup_prdt (struct channel *c, block_sector_t cmd_cnt)
+{
+  struct block_request *r = c->req;
+  block_sector_t idx = c->idx;
+  struct prd *prd = NULL;
+  size_t prd_cnt = 0;
+  block_sector_t i;
+
+  for (i = 0; i < cmd_cnt; i++)
+    {
+      const void *buffer = r->buffers[idx];
+      uint32_t addr, left;
+
+      if (++idx >= r->cnt)
+        {
+          r = r->next;
+          idx = 0;
+        }
+
+      /* The controller transfers words, and it can only reach
+         memory that the kernel maps directly. */
+      if (!is_kernel_vaddr (buffer) || ((uintptr_t) buffer & 1))
+        return false;
+
+      addr = vtop (buffer);
+      for (left = BLOCK_SECTOR_SIZE; left > 0; )
+        {
+          /* A region may not cross a 64 kB boundary. */
+          uint32_t chunk = 0x10000 - (addr & 0xffff);
+          if (chunk > left)
+            chunk = left;
+
+          if (prd != NULL && prd->addr + prd->size == addr
+              && (prd->addr & ~0xffff) == ((addr + chunk - 1) & ~0xffff)
+              && prd->size + chunk < 0x10000)
+            prd->size += chunk;
+          else
+            {
+              if (prd_cnt >= PRD_CNT)
+                return false;
+              prd = &c->prdt[prd_cnt++];
+              prd->addr = addr;
+              prd->size = chunk;
+              prd->flags = 0;
+            }
+          addr += chunk;
+          left -= chunk;
+        }
+    }
+  prd->flags = PRD_EOT;
+  return true;
+}
+
+/* Moves the next DRQ block of channel C's current PIO command
+   between the disk and the run's buffers. */
 static void
-ide_read (void *d_, block_sector_t sec_no, void *buffer)
+pio_block (struct channel *c)
 {
-  struct ata_disk *d = d_;
-  struct channel *c = d->channel;
-  lock_acquire (&c->lock);
-  select_sector (d, sec_no);
-  issue_pio_command (c, CMD_READ_SECTOR_RETRY);
+  block_sector_t cnt = c->cmd_left;
+  block_sector_t i;
+
+  if (cnt > (block_sector_t) c->disk->multiple)
+    cnt = c->disk->multiple;
+  for (i = 0; i < cnt; i++)
+    {
+      if (c->run->write)
+        output_sector (c, next_buffer (c));
+      else
+        input_sector (c, next_buffer (c));
+    }
+  c->cmd_left -= cnt;
+  c->left -= cnt;
+  c->sec_no += cnt;
+}
+
+/* Reads the next C->cmd_left sectors of channel C's current run
+   in PIO mode.  The disk interrupts once per DRQ block. */
+static void
+pio_read (struct channel *c)
+{
+  struct ata_disk *d = c->disk;
+
+  select_sector (d, c->sec_no, c->cmd_left);
+  issue_command (c, d->multiple > 1 ? CMD_READ_MULTIPLE
+                                    : CMD_READ_SECTOR_RETRY);
+  while (c->cmd_left > 0)
+    {
+      sema_down (&c->completion_wait);
+      if (!wait_while_busy (d))
+        PANIC ("%s: disk read failed, sector=%"PRDSNu, d->name, c->sec_no);
+      pio_block (c);
+    }
+}
+
+/* Writes the next C->cmd_left sectors of channel C's current
+   run in PIO mode. */
+static void
+pio_write (struct channel *c)
+{
+  struct ata_disk *d = c->disk;
+  bool first = true;
+
+  select_sector (d, c->sec_no, c->cmd_left);
+  issue_command (c, d->multiple > 1 ? CMD_WRITE_MULTIPLE
+                                    : CMD_WRITE_SECTOR_RETRY);
+  while (c->cmd_left > 0)
+    {
+      /* The disk interrupts after each block to ask for the
+         next one, and once more when the command completes. */
+      if (!first)
+        sema_down (&c->completion_wait);
+      first = false;
+      if (!wait_while_busy (d))
+        PANIC ("%s: disk write failed, sector=%"PRDSNu, d->name, c->sec_no);
+      pio_block (c);
+    }
   sema_down (&c->completion_wait);
-  if (!wait_while_busy (d))
-    PANIC ("%s: disk read failed, sector=%"PRDSNu, d->name, sec_no);
-  input_sector (c, buffer);
-  lock_release (&c->lock);
 }
 
-/* Write sector SEC_NO to disk D from BUFFER, which must contain
-   BLOCK_SECTOR_SIZE bytes.  Returns after the disk has
-   acknowledged receiving the data.
-   Internally synchronizes accesses to disks, so external
-   per-disk locking is unneeded. */
+/* Transfers the next C->cmd_left sectors of channel C's current
+   run by DMA, between the disk and the memory described by C's
+   PRD table, which setup_prdt() must already have filled in.
+   The CPU is free for other threads until the single completion
+   interrupt arrives. */
 static void
-ide_write (void *d_, block_sector_t sec_no, const void *buffer)
+dma_transfer (struct channel *c)
 {
-  struct ata_disk *d = d_;
-  struct channel *c = d->channel;
-  lock_acquire (&c->lock);
-  select_sector (d, sec_no);
-  issue_pio_command (c, CMD_WRITE_SECTOR_RETRY);
-  if (!wait_while_busy (d))
-    PANIC ("%s: disk write failed, sector=%"PRDSNu, d->name, sec_no);
-  output_sector (c, buffer);
+  struct ata_disk *d = c->disk;
+  bool write = c->run->write;
+  uint8_t bm_command = write ? 0 : BM_CMD_READ;
+  uint8_t bm_status;
+  block_sector_t i;
+
+  outl (c->bm_base + BM_PRDT, vtop (c->prdt));
+  outb (c->bm_base + BM_COMMAND, bm_command);
+  outb (c->bm_base + BM_STATUS,
+        inb (c->bm_base + BM_STATUS) | BM_STA_ERR | BM_STA_IRQ);
+
+  select_sector (d, c->sec_no, c->cmd_left);
+  issue_command (c, write ? CMD_WRITE_DMA : CMD_READ_DMA);
+  outb (c->bm_base + BM_COMMAND, bm_command | BM_CMD_START);
   sema_down (&c->completion_wait);
-  lock_release (&c->lock);
+  outb (c->bm_base + BM_COMMAND, bm_command);
+
+  bm_status = inb (c->bm_base + BM_STATUS);
+  outb (c->bm_base + BM_STATUS, bm_status | BM_STA_ERR | BM_STA_IRQ);
+  if ((bm_status & BM_STA_ERR) || (inb (reg_status (c)) & STA_ERR))
+    PANIC ("%s: disk DMA %s failed, sector=%"PRDSNu,
+           d->name, write ? "write" : "read", c->sec_no);
+
+  for (i = 0; i < c->cmd_left; i++)
+    next_buffer (c);
+  c->left -= c->cmd_left;
+  c->sec_no += c->cmd_left;
+  c->cmd_left = 0;
+}
+
+/* Takes the next run of requests for channel C from its disks'
+   queues, taking turns between the two disks, and makes it C's
+   current run.  Returns false if both queues are empty. */
+static bool
+next_run (struct channel *c)
+{
+  enum intr_level old_level = intr_disable ();
+  bool found = false;
+  int i;
+
+  for (i = 0; i < 2 && !found; i++)
+    {
+      struct ata_disk *d = &c->devices[(c->next_dev + i) % 2];
+      struct block_request *run = block_queue_pop (&d->queue,
+                                                   MAX_SECTORS_PER_CMD);
+      if (run != NULL)
+        {
+          struct block_request *r;
+
+          c->next_dev = !d->dev_no;
+          c->disk = d;
+          c->run = c->req = run;
+          c->idx = 0;
+          c->sec_no = run->sector;
+          c->left = 0;
+          for (r = run; r != NULL; r = r->next)
+            c->left += r->cnt;
+          found = true;
+        }
+    }
+  intr_set_level (old_level);
+
+  return found;
+}
+
+/* Carries out channel C's current run, issuing one command per
+   MAX_SECTORS_PER_CMD sectors, and completes its requests. */
+static void
+do_run (struct channel *c)
+{
+  while (c->left > 0)
+    {
+      c->cmd_left = c->left < MAX_SECTORS_PER_CMD
+                    ? c->left : MAX_SECTORS_PER_CMD;
+      if (c->disk->dma && setup_prdt (c, c->cmd_left))
+        dma_transfer (c);
+      else if (!c->run->write)
+        pio_read (c);
+      else
+        pio_write (c);
+    }
+  block_request_done (c->run);
+}
+
+/* Dispatcher thread for channel C_.  Carries out the requests
+   queued on C's disks, one run at a time. */
+static void
+dispatcher (void *c_)
+{
+  struct channel *c = c_;
+
+  for (;;)
+    {
+      /* A run may include several requests, so WORK can be
+         up'd more times than there are runs. */
+      sema_down (&c->work);
+      while (next_run (c))
+        do_run (c);
+    }
+}
+
+/* Queues transfer R on disk D and returns.  D's channel's
+   dispatcher carries it out. */
+static void
+ide_submit (void *d_, struct block_request *r)
+{
+  struct ata_disk *d = d_;
+  enum intr_level old_level = intr_disable ();
+
+  block_queue_push (&d->queue, r);
+  intr_set_level (old_level);
+  sema_up (&d->channel->work);
 }
 
 static struct block_operations ide_operations =
   {
-    ide_read,
-    ide_write
+    NULL,
+    NULL,
+    NULL,
+    NULL,
+    ide_submit
   };
 
 /* Selects device D, waiting for it to become ready, and then
-   writes SEC_NO to the disk's sector selection registers.  (We
-   use LBA mode.) */
+   writes SEC_NO and the sector count CNT to the disk's sector
+   selection registers.  (We use LBA mode.) */
 static void
-select_sector (struct ata_disk *d, block_sector_t sec_no)
+select_sector (struct ata_disk *d, block_sector_t sec_no, block_sector_t cnt)
 {
   struct channel *c = d->channel;
 
   ASSERT (sec_no < (1UL << 28));
+  ASSERT (cnt > 0 && cnt <= MAX_SECTORS_PER_CMD);
   
   select_device_wait (d);
-  outb (reg_nsect (c), 1);
+  outb (reg_nsect (c), cnt == MAX_SECTORS_PER_CMD ? 0 : cnt);
   outb (reg_lbal (c), sec_no);
   outb (reg_lbam (c), sec_no >> 8);
   outb (reg_lbah (c), (sec_no >> 16));
@@ -404,7 +797,7 @@ select_sector (struct ata_disk *d, block_sector_t sec_no)
 /* Writes COMMAND to channel C and prepares for receiving a
    completion interrupt. */
 static void
-issue_pio_command (struct channel *c, uint8_t command) 
+issue_command (struct channel *c, uint8_t command) 
 {
   /* Interrupts must be enabled or our semaphore will never be
      up'd by the completion handler. */
@@ -0,0 +1,100 @@
+#include "devices/pci.h"
+#include <debug.h>
+#include "threads/interrupt.h"
+#include "threads/io.h"
+
+/* This code reads and writes PCI configuration space using
+   configuration mechanism #1, which every PC chipset that Bochs
+   and QEMU emulate supports.  It is only as much of PCI as the
+   disk driver needs to find and program its bus-master
+   controller. */
+
+/* I/O ports for configuration mechanism #1. */
+#define PCI_CONFIG_ADDRESS 0xcf8 /* Selects bus, device, function, reg. */
+#define PCI_CONFIG_DATA 0xcfc    /* Data for the selected register. */
+
+/* Header type bit indicating a multi-function device. */
+#define PCI_HEADER_MULTIFUNC 0x80
+
+/* Returns the CONFIG_ADDRESS value that selects register REG of
+   device D. */
+static uint32_t
+config_address (const struct pci_device *d, uint8_t reg)
+{
+  ASSERT (d->dev < 32 && d->func < 8);
+  ASSERT (reg % 4 == 0);
+
+  return (0x80000000 | ((uint32_t) d->bus << 16) | ((uint32_t) d->dev << 11)
+          | ((uint32_t) d->func << 8) | reg);
+}
+
+/* Returns the 32-bit configuration register REG of device D. */
+uint32_t
+pci_read_config (const struct pci_device *d, uint8_t reg)
+{
+  enum intr_level old_level;
+  uint32_t value;
+
+  /* The address/data port pair must not be interleaved with
+     another access. */
+  old_level = intr_disable ();
+  outl (PCI_CONFIG_ADDRESS, config_address (d, reg));
+  value = inl (PCI_CONFIG_DATA);
+  intr_set_level (old_level);
+
+  return value;
+}
+
+/* Writes VALUE to the 32-bit configuration register REG of
+   device D. */
+void
+pci_write_config (const struct pci_device *d, uint8_t reg, uint32_t value)
+{
+  enum intr_level old_level;
+
+  old_level = intr_disable ();
+  outl (PCI_CONFIG_ADDRESS, config_address (d, reg));
+  outl (PCI_CONFIG_DATA, value);
+  intr_set_level (old_level);
+}
+
+/* Searches every PCI bus for the first function whose class
+   code is CLASS and whose subclass is SUBCLASS.  If one is
+   found, stores its location in *D and returns true.
+   Otherwise, returns false. */
+bool
+pci_find_class (uint8_t class, uint8_t subclass, struct pci_device *d)
+{
+  unsigned bus, dev, func;
+
+  for (bus = 0; bus < 256; bus++)
+    for (dev = 0; dev < 32; dev++)
+      for (func = 0; func < 8; func++)
+        {
+          uint32_t class_reg;
+
+          d->bus = bus;
+          d->dev = dev;
+          d->func = func;
+          if ((pci_read_config (d, PCI_REG_ID) & 0xffff) == 0xffff)
+            {
+              /* No device here.  If function 0 is absent, so are
+                 the others. */
+              if (func == 0)
+                break;
+              continue;
+            }
+
+          class_reg = pci_read_config (d, PCI_REG_CLASS);
+          if ((class_reg >> 24) == class
+              && ((class_reg >> 16) & 0xff) == subclass)
+            return true;
+
+          if (func == 0
+              && !((pci_read_config (d, PCI_REG_HEADER) >> 16)
+                   & PCI_HEADER_MULTIFUNC))
+            break;
+        }
+
+  return false;
+}
@@ -0,0 +1,178 @@
+#include "devices/stripe.h"
+#include <debug.h>
+#include <stdio.h>
+#include <string.h>
+#include "threads/interrupt.h"
+#include "threads/malloc.h"
+
+/* A stripe is a virtual block device that spreads its sectors
+   across several member devices, RAID-0 style.  Its sectors are
+   grouped into chunks of STRIPE_CHUNK sectors, which are dealt
+   to the members in turn, so that a large transfer keeps all of
+   the members busy at once.  There is no redundancy: losing any
+   member loses the whole stripe. */
+
+/* Sectors per chunk. */
+#define STRIPE_CHUNK 8
+
+/* A stripe. */
+struct stripe
+  {
+    size_t cnt;                         /* Number of members. */
+    struct block *members[STRIPE_MAX];  /* Member devices. */
+  };
+
+/* A transfer on a stripe, split into one request per member. */
+struct stripe_io
+  {
+    struct block_request *parent;       /* Transfer on the stripe. */
+    size_t pending;                     /* Member requests not done. */
+    struct block_request subs[STRIPE_MAX]; /* Member requests. */
+    void *buffers[];                    /* PARENT's buffers, by member. */
+  };
+
+static struct block_operations stripe_operations;
+
+/* Creates and registers a block device named NAME, of the given
+   TYPE, that stripes its sectors across the CNT devices in
+   MEMBERS.  Its size is a whole number of chunks on each member,
+   limited by the smallest member.  Panics on failure. */
+struct block *
+stripe_create (const char *name, enum block_type type,
+               struct block *members[], size_t cnt)
+{
+  struct stripe *s;
+  block_sector_t chunks;
+  char extra_info[128];
+  size_t i;
+
+  if (cnt < 2 || cnt > STRIPE_MAX)
+    PANIC ("%s: stripe needs 2 to %d devices", name, STRIPE_MAX);
+
+  s = malloc (sizeof *s);
+  if (s == NULL)
+    PANIC ("%s: failed to allocate stripe", name);
+  s->cnt = cnt;
+
+  chunks = block_size (members[0]) / STRIPE_CHUNK;
+  strlcpy (extra_info, "stripe of", sizeof extra_info);
+  for (i = 0; i < cnt; i++)
+    {
+      block_sector_t member_chunks = block_size (members[i]) / STRIPE_CHUNK;
+      if (member_chunks < chunks)
+        chunks = member_chunks;
+      s->members[i] = members[i];
+      snprintf (extra_info + strlen (extra_info),
+                sizeof extra_info - strlen (extra_info),
+                "%s %s", i > 0 ? "," : "", block_name (members[i]));
+    }
+
+  return block_register (name, type, extra_info,
+                         chunks * STRIPE_CHUNK * cnt,
+                         &stripe_operations, s);
+}
+
+/* Completion function for the member requests of IO_.  When
+   the last one is done, completes the transfer on the stripe.
+   Frees IO_, so the members' drivers must not call this from an
+   interrupt handler, which the IDE driver does not. */
+static void
+stripe_done (struct block_request *sub UNUSED, void *io_)
+{
+  struct stripe_io *io = io_;
+  struct block_request *parent = io->parent;
+  enum intr_level old_level;
+  bool last;
+
+  old_level = intr_disable ();
+  last = --io->pending == 0;
+  intr_set_level (old_level);
+
+  if (last)
+    {
+      free (io);
+      parent->next = NULL;
+      block_request_done (parent);
+    }
+}
+
+/* Maps SECTOR on stripe S to a member, returned in *MEMBER, and
+   the sector within that member, which is returned. */
+static block_sector_t
+map_sector (const struct stripe *s, block_sector_t sector, size_t *member)
+{
+  block_sector_t chunk = sector / STRIPE_CHUNK;
+  *member = chunk % s->cnt;
+  return chunk / s->cnt * STRIPE_CHUNK + sector % STRIPE_CHUNK;
+}
+
+/* Starts transfer R on stripe S_.  Splits R into at most one
+   request per member, since the sectors of R that fall on any
+   one member are consecutive there, and submits them all so
+   that the members work in parallel. */
+static void
+stripe_submit (void *s_, struct block_request *r)
+{
+  struct stripe *s = s_;
+  block_sector_t counts[STRIPE_MAX], starts[STRIPE_MAX], offsets[STRIPE_MAX];
+  struct stripe_io *io;
+  block_sector_t i, ofs;
+  size_t m;
+
+  io = malloc (sizeof *io + r->cnt * sizeof *io->buffers);
+  if (io == NULL)
+    PANIC ("stripe: out of memory for %"PRDSNu"-sector request", r->cnt);
+  io->parent = r;
+
+  /* Count the sectors that fall on each member. */
+  for (m = 0; m < s->cnt; m++)
+    counts[m] = 0;
+  for (i = 0; i < r->cnt; i++)
+    {
+      block_sector_t member_sector = map_sector (s, r->sector + i, &m);
+      if (counts[m]++ == 0)
+        starts[m] = member_sector;
+    }
+
+  /* Gather each member's buffers together. */
+  io->pending = 0;
+  for (m = ofs = 0; m < s->cnt; m++)
+    {
+      offsets[m] = ofs;
+      ofs += counts[m];
+      if (counts[m] > 0)
+        io->pending++;
+    }
+  for (i = 0; i < r->cnt; i++)
+    {
+      map_sector (s, r->sector + i, &m);
+      io->buffers[offsets[m]++] = r->buffers[i];
+    }
+
+  /* Submit.  PENDING holds one extra count until all the
+     member requests are submitted, in case some complete before
+     we are done. */
+  io->pending++;
+  for (m = ofs = 0; m < s->cnt; ofs += counts[m], m++)
+    if (counts[m] > 0)
+      {
+        struct block_request *sub = &io->subs[m];
+        sub->sector = starts[m];
+        sub->cnt = counts[m];
+        sub->buffers = &io->buffers[ofs];
+        sub->write = r->write;
+        sub->complete = stripe_done;
+        sub->aux = io;
+        block_submit (s->members[m], sub);
+      }
+  stripe_done (NULL, io);
+}
+
+static struct block_operations stripe_operations =
+  {
+    NULL,
+    NULL,
+    NULL,
+    NULL,
+    stripe_submit
+  };
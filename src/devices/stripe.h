@@ -0,0 +1,13 @@
+#ifndef DEVICES_STRIPE_H
+#define DEVICES_STRIPE_H
+
+#include <stddef.h>
+#include "devices/block.h"
+
+/* Most block devices that a stripe may span. */
+#define STRIPE_MAX 4
+
+struct block *stripe_create (const char *name, enum block_type,
+                             struct block *members[], size_t cnt);
+
+#endif /* devices/stripe.h */
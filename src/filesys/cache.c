@@ -1,6 +1,7 @@
 #include "cache.h"
 #include "devices/block.h"
 #include "list.h"
+#include "threads/malloc.h"
 #include "threads/synch.h"
 #include "devices/timer.h"
 #include "filesys.h"
@@ -33,7 +34,7 @@ void write_behind(void)
 
 void cache_init(void)
 {
-    lock_init(&cache_global_lock);
+    lock_init_named(&cache_global_lock, "cache_global_lock");
     lock_acquire(&cache_global_lock);
     sema_init(&read_ahead_sema, 0);
     list_init(&read_ahead_list);
@@ -41,24 +42,57 @@ void cache_init(void)
         cache[i].sector_id=CACHE_UNUSED;
         cache[i].dirty=false;
         cache[i].second_chance=true;
-        lock_init(&cache[i].lock);
+        lock_init_named(&cache[i].lock, "cache entry");
     }
     thread_create ("write-behind", PRI_DEFAULT, (thread_func *) write_behind, NULL);
     thread_create ("read-ahead", PRI_DEFAULT, (thread_func *) read_ahead_proc, NULL);
     lock_release(&cache_global_lock);
 }
 
+// Called when the write-back of a cache entry completes.
+static void cache_write_done(struct block_request *r UNUSED, void *done)
+{
+    sema_up(done);
+}
+
 // Write back all dirty cache.
+// All dirty entries are queued at once, so that the block layer can sort them
+// and merge entries holding consecutive sectors into one request.
+// Each entry stays locked until its write completes, so its data cannot change
+// under the write, and a write after that marks it dirty again.
 void cache_write_back(void)
 {
+    struct semaphore done;
+    int n=0;
+    sema_init(&done, 0);
     lock_acquire(&cache_global_lock);
     for(int i=0; i<CACHE_SIZE; i++) {
-        if (cache[i].sector_id==CACHE_UNUSED) {
+        if (cache[i].sector_id==CACHE_UNUSED || !cache[i].dirty) {
+            continue;
+        }
+        lock_acquire(&cache[i].lock);
+        if (!cache[i].dirty) {
+            lock_release(&cache[i].lock);
             continue;
         }
-        if (cache[i].dirty) {
-            block_write(fs_device, cache[i].sector_id, cache[i].data);
-            cache[i].dirty=false;
+        struct block_request *r=&cache[i].request;
+        cache[i].buffer=cache[i].data;
+        r->sector=cache[i].sector_id;
+        r->cnt=1;
+        r->buffers=&cache[i].buffer;
+        r->write=true;
+        r->complete=cache_write_done;
+        r->aux=&done;
+        block_submit(fs_device, r);
+        cache[i].dirty=false;
+        n++;
+    }
+    while (n-->0) {
+        sema_down(&done);
+    }
+    for(int i=0; i<CACHE_SIZE; i++) {
+        if (lock_held_by_current_thread(&cache[i].lock)) {
+            lock_release(&cache[i].lock);
         }
     }
     lock_release(&cache_global_lock);
@@ -15,6 +15,8 @@ struct cache
     bool second_chance; // For second chance algorithm
     uint8_t data[BLOCK_SECTOR_SIZE]; // The data of this cache
     struct lock lock; // lock it while reading or writing cache
+    struct block_request request; // Used to write back this cache
+    void *buffer; // Buffer array of <request>, pointing to <data>
 };
 
 extern struct lock cache_global_lock;
@@ -18,7 +18,7 @@ static struct lock filesys_lock; /* Lock for file system operations. */
 void
 filesys_lock_init (void)
 {
-  lock_init (&filesys_lock);
+  lock_init_named (&filesys_lock, "filesys_lock");
 }
 void
 filesys_lock_acquire (void)
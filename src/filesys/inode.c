@@ -34,6 +34,7 @@ struct inode
     int open_cnt;                       /* Number of openers. */
     bool removed;                       /* True if deleted, false otherwise. */
     int deny_write_cnt;                 /* 0: writes ok, >0: deny writes. */
+    unsigned write_cnt;                 /* Number of writes since opened. */
     struct inode_disk data;             /* Inode content. */
     struct lock lock; // inode IO lock
   };
@@ -152,10 +153,11 @@ inode_open (block_sector_t sector)
 
   /* Initialize. */
   list_push_front (&open_inodes, &inode->elem);
-  lock_init(&inode->lock);
+  lock_init_named(&inode->lock, "inode");
   inode->sector = sector;
   inode->open_cnt = 1;
   inode->deny_write_cnt = 0;
+  inode->write_cnt = 0;
   inode->removed = false;
   //block_read (fs_device, inode->sector, &inode->data);
   cache_read(inode->sector, &inode->data, 0, BLOCK_SECTOR_SIZE);
@@ -276,6 +278,7 @@ inode_write_at (struct inode *inode, const void *buffer_, off_t size,
     return 0;
 
   lock_acquire(&inode->lock);
+  inode->write_cnt++;
 
   // Extend inode if necessary.
   if (offset + size > inode->data.length) {
@@ -341,6 +344,23 @@ inode_allow_write (struct inode *inode)
   inode->deny_write_cnt--;
 }
 
+/* Returns the number of times INODE has been written to since it
+   was opened, so that a caller can tell whether its contents may
+   have changed since it last looked. */
+unsigned
+inode_write_cnt (const struct inode *inode)
+{
+  return inode->write_cnt;
+}
+
+/* Returns true if INODE has been removed, so that it will be
+   freed once its last opener closes it. */
+bool
+inode_is_removed (const struct inode *inode)
+{
+  return inode->removed;
+}
+
 /* Returns the length, in bytes, of INODE's data. */
 off_t
 inode_length (const struct inode *inode)
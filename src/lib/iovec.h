@@ -0,0 +1,17 @@
+#ifndef __LIB_IOVEC_H
+#define __LIB_IOVEC_H
+
+#include <stddef.h>
+
+/* A buffer for the readv and writev system calls, which transfer
+   data to or from an array of them in a single call. */
+struct iovec
+  {
+    void *iov_base;             /* Start of buffer. */
+    size_t iov_len;             /* Number of bytes in buffer. */
+  };
+
+/* Maximum number of buffers in one readv or writev call. */
+#define IOV_MAX 64
+
+#endif /* lib/iovec.h */
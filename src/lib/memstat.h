@@ -0,0 +1,24 @@
+#ifndef __LIB_MEMSTAT_H
+#define __LIB_MEMSTAT_H
+
+/* Paging and memory statistics, as reported by the memstat
+   system call.  Counts are since boot. */
+struct memstat
+  {
+    /* Calling process. */
+    unsigned minor_faults;      /* Faults served without I/O. */
+    unsigned major_faults;      /* Faults that read a file or swap. */
+
+    /* All processes. */
+    unsigned total_minor_faults; /* Faults served without I/O. */
+    unsigned total_major_faults; /* Faults that read a file or swap. */
+    unsigned evictions;         /* Frames taken from their pages. */
+    unsigned swap_ins;          /* Pages read from swap. */
+    unsigned swap_outs;         /* Pages written to swap. */
+
+    /* Current state. */
+    unsigned kernel_free;       /* Free pages in the kernel pool. */
+    unsigned user_free;         /* Free pages in the user pool. */
+  };
+
+#endif /* lib/memstat.h */
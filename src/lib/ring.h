@@ -0,0 +1,75 @@
+#ifndef __LIB_RING_H
+#define __LIB_RING_H
+
+/* Submission and completion rings for the ring_enter system
+   call, which carries out a batch of requests in one call.
+
+   A process fills in request entries in the submission ring,
+   advancing its tail, and then calls ring_enter().  The kernel
+   consumes entries from the head of the submission ring, carries
+   them out in order, and appends an entry with the result of
+   each one to the tail of the completion ring, from whose head
+   the process collects them.  Head and tail are free-running
+   counters: entry I of a ring is ENTRIES[I % RING_SIZE]. */
+
+/* Number of entries in each ring. */
+#define RING_SIZE 128
+
+/* Request operations.  Each takes the arguments of the system
+   call of the same name from the named members of the request:
+     - RING_OP_OPEN: BUF (file name).
+     - RING_OP_CREATE: BUF (file name), LEN (initial size).
+     - RING_OP_READ, RING_OP_WRITE: FD, BUF, LEN.
+     - RING_OP_CLOSE: FD.
+   The result is the system call's return value, or 0 for
+   RING_OP_CLOSE.  An unknown operation has result -1. */
+enum ring_op
+  {
+    RING_OP_OPEN,
+    RING_OP_CREATE,
+    RING_OP_READ,
+    RING_OP_WRITE,
+    RING_OP_CLOSE
+  };
+
+/* A request in the submission ring. */
+struct ring_sqe
+  {
+    int op;                     /* A RING_OP_* operation. */
+    int fd;                     /* File descriptor. */
+    void *buf;                  /* Buffer or file name. */
+    unsigned len;               /* Buffer length or file size. */
+    unsigned user_data;         /* Copied to the completion. */
+  };
+
+/* A completion in the completion ring. */
+struct ring_cqe
+  {
+    unsigned user_data;         /* From the request. */
+    int result;                 /* Result of the request. */
+  };
+
+/* Submission ring.  The process advances TAIL, the kernel
+   HEAD. */
+struct ring_sq
+  {
+    unsigned head, tail;
+    struct ring_sqe entries[RING_SIZE];
+  };
+
+/* Completion ring.  The kernel advances TAIL, the process
+   HEAD. */
+struct ring_cq
+  {
+    unsigned head, tail;
+    struct ring_cqe entries[RING_SIZE];
+  };
+
+/* A pair of rings, each in a page of its own. */
+struct ring
+  {
+    struct ring_sq sq __attribute__ ((aligned (4096)));
+    struct ring_cq cq __attribute__ ((aligned (4096)));
+  };
+
+#endif /* lib/ring.h */
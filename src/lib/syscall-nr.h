@@ -28,7 +28,20 @@ enum
     SYS_MKDIR,                  /* Create a directory. */
     SYS_READDIR,                /* Reads a directory entry. */
     SYS_ISDIR,                  /* Tests if a fd represents a directory. */
-    SYS_INUMBER                 /* Returns the inode number for a fd. */
+    SYS_INUMBER,                /* Returns the inode number for a fd. */
+
+    /* Extensions. */
+    SYS_FORK,                   /* Duplicate this process. */
+    SYS_MEMSTAT,                /* Obtain paging statistics. */
+    SYS_READV,                  /* Read into several buffers. */
+    SYS_WRITEV,                 /* Write from several buffers. */
+    SYS_PREAD,                  /* Read at a given file offset. */
+    SYS_PWRITE,                 /* Write at a given file offset. */
+    SYS_ENTER_RING,             /* Carry out queued requests. */
+    SYS_SBRK,                   /* Grow or shrink the heap. */
+    SYS_WAITPID,                /* Wait for a child, with options. */
+
+    SYS_CNT                     /* Number of system calls. */
   };
 
 #endif /* lib/syscall-nr.h */
@@ -0,0 +1,351 @@
+#include <stdlib.h>
+#include <debug.h>
+#include <round.h>
+#include <stdint.h>
+#include <string.h>
+#include <syscall.h>
+
+/* A malloc() for user programs, built on the heap that sbrk()
+   grows and shrinks.
+
+   It works like the kernel's malloc() in threads/malloc.c.  The
+   size of each small request is rounded up to a power of 2 and
+   assigned to the "descriptor" for blocks of that size, which
+   keeps a list of free blocks.  When the list is empty, the heap
+   is grown by a page, called an "arena", which is divided into
+   blocks that are all added to the list.  Each size has its own
+   list, so allocating and freeing small blocks never searches.
+   Arenas are not given back when all their blocks are free,
+   because blocks of the same size are likely to be wanted again.
+   A user process has only one thread, so no locking is needed.
+
+   Blocks bigger than 1 kB get a run of pages of their own, with
+   the number of pages in the arena header at its start.  Freed
+   runs go on a list that later big requests are satisfied from,
+   first fit, splitting runs that are longer than needed.  Runs
+   that end up at the end of the heap are given back by shrinking
+   it instead. */
+
+/* Size of a page.  The heap's pages are obtained from sbrk()
+   aligned on page boundaries, so that the arena of any block can
+   be found by rounding its address down. */
+#define PAGE_SIZE 4096
+
+/* Descriptor. */
+struct desc
+  {
+    size_t block_size;          /* Size of each element in bytes. */
+    size_t blocks_per_arena;    /* Number of blocks in an arena. */
+    struct block *free_list;    /* List of free blocks. */
+  };
+
+/* Magic number for detecting arena corruption. */
+#define ARENA_MAGIC 0x9a548eed
+
+/* Arena. */
+struct arena
+  {
+    unsigned magic;             /* Always set to ARENA_MAGIC. */
+    struct desc *desc;          /* Owning descriptor, null for big block. */
+    size_t page_cnt;            /* Pages in arena. */
+    struct arena *next;         /* Next free run of pages, if free. */
+  };
+
+/* Free block. */
+struct block
+  {
+    struct block *next;         /* Next free block. */
+  };
+
+/* Our set of descriptors. */
+static struct desc descs[10];   /* Descriptors. */
+static size_t desc_cnt;         /* Number of descriptors. */
+
+/* Free runs of pages, in no particular order. */
+static struct arena *free_runs;
+
+static struct arena *block_to_arena (struct block *);
+static struct block *arena_to_block (struct arena *, size_t idx);
+
+/* Initializes the descriptors. */
+static void
+init_descs (void)
+{
+  size_t block_size;
+
+  for (block_size = 16; block_size < PAGE_SIZE / 2; block_size *= 2)
+    {
+      struct desc *d = &descs[desc_cnt++];
+      ASSERT (desc_cnt <= sizeof descs / sizeof *descs);
+      d->block_size = block_size;
+      d->blocks_per_arena = (PAGE_SIZE - sizeof (struct arena)) / block_size;
+      d->free_list = NULL;
+    }
+}
+
+/* Grows the heap by PAGE_CNT pages and returns the first of
+   them, as an arena with only its magic number set.  Returns a
+   null pointer if the heap cannot grow that much. */
+static struct arena *
+get_pages (size_t page_cnt)
+{
+  uint8_t *brk = sbrk (0);
+  size_t pad = ROUND_UP ((uintptr_t) brk, PAGE_SIZE) - (uintptr_t) brk;
+  struct arena *a;
+
+  if (brk == (void *) -1 || page_cnt > (INTPTR_MAX - pad) / PAGE_SIZE)
+    return NULL;
+  brk = sbrk (pad + page_cnt * PAGE_SIZE);
+  if (brk == (void *) -1)
+    return NULL;
+
+  a = (struct arena *) (brk + pad);
+  a->magic = ARENA_MAGIC;
+  return a;
+}
+
+/* Returns a run of PAGE_CNT pages, from the free runs if one is
+   long enough, otherwise by growing the heap.  Returns a null
+   pointer if memory is not available. */
+static struct arena *
+alloc_run (size_t page_cnt)
+{
+  struct arena **ap, *a;
+
+  for (ap = &free_runs; *ap != NULL; ap = &(*ap)->next)
+    if ((*ap)->page_cnt >= page_cnt)
+      break;
+
+  a = *ap;
+  if (a == NULL)
+    return get_pages (page_cnt);
+  if (a->page_cnt > page_cnt)
+    {
+      /* Put the pages we don't need back in the list. */
+      struct arena *rest = (struct arena *) ((uint8_t *) a
+                                             + page_cnt * PAGE_SIZE);
+      rest->magic = ARENA_MAGIC;
+      rest->desc = NULL;
+      rest->page_cnt = a->page_cnt - page_cnt;
+      rest->next = a->next;
+      *ap = rest;
+    }
+  else
+    *ap = a->next;
+  return a;
+}
+
+/* Adds run A to the free runs, then gives back every free run
+   at the end of the heap by shrinking it. */
+static void
+free_run (struct arena *a)
+{
+  a->next = free_runs;
+  free_runs = a;
+
+  for (;;)
+    {
+      uint8_t *brk = sbrk (0);
+      struct arena **ap;
+
+      for (ap = &free_runs; *ap != NULL; ap = &(*ap)->next)
+        if ((uint8_t *) *ap + (*ap)->page_cnt * PAGE_SIZE == brk)
+          break;
+      if (*ap == NULL)
+        break;
+
+      a = *ap;
+      *ap = a->next;
+      sbrk (-(intptr_t) (a->page_cnt * PAGE_SIZE));
+    }
+}
+
+/* Obtains and returns a new block of at least SIZE bytes.
+   Returns a null pointer if memory is not available. */
+void *
+malloc (size_t size)
+{
+  struct desc *d;
+  struct block *b;
+  struct arena *a;
+
+  /* A null pointer satisfies a request for 0 bytes. */
+  if (size == 0)
+    return NULL;
+
+  if (desc_cnt == 0)
+    init_descs ();
+
+  /* Find the smallest descriptor that satisfies a SIZE-byte
+     request. */
+  for (d = descs; d < descs + desc_cnt; d++)
+    if (d->block_size >= size)
+      break;
+  if (d == descs + desc_cnt)
+    {
+      /* SIZE is too big for any descriptor.
+         Allocate enough pages to hold SIZE plus an arena. */
+      size_t page_cnt;
+
+      if (size > SIZE_MAX - PAGE_SIZE)
+        return NULL;
+      page_cnt = DIV_ROUND_UP (size + sizeof *a, PAGE_SIZE);
+      a = alloc_run (page_cnt);
+      if (a == NULL)
+        return NULL;
+
+      /* Initialize the arena to indicate a big block of PAGE_CNT
+         pages, and return it. */
+      a->desc = NULL;
+      a->page_cnt = page_cnt;
+      a->next = NULL;
+      return a + 1;
+    }
+
+  /* If the free list is empty, create a new arena. */
+  if (d->free_list == NULL)
+    {
+      size_t i;
+
+      a = get_pages (1);
+      if (a == NULL)
+        return NULL;
+
+      /* Initialize arena and add its blocks to the free list, in
+         order so that they are handed out in address order. */
+      a->desc = d;
+      a->page_cnt = 1;
+      a->next = NULL;
+      for (i = d->blocks_per_arena; i-- > 0; )
+        {
+          b = arena_to_block (a, i);
+          b->next = d->free_list;
+          d->free_list = b;
+        }
+    }
+
+  /* Get a block from free list and return it. */
+  b = d->free_list;
+  d->free_list = b->next;
+  return b;
+}
+
+/* Allocates and return A times B bytes initialized to zeroes.
+   Returns a null pointer if memory is not available. */
+void *
+calloc (size_t a, size_t b)
+{
+  void *p;
+  size_t size;
+
+  /* Calculate block size and make sure it fits in size_t. */
+  if (b != 0 && a > SIZE_MAX / b)
+    return NULL;
+  size = a * b;
+
+  /* Allocate and zero memory.  Pages fresh from the heap are
+     zeroed already, but a block may have been used before. */
+  p = malloc (size);
+  if (p != NULL)
+    memset (p, 0, size);
+
+  return p;
+}
+
+/* Returns the number of bytes allocated for BLOCK. */
+static size_t
+block_size (void *block)
+{
+  struct arena *a = block_to_arena (block);
+  struct desc *d = a->desc;
+
+  return d != NULL ? d->block_size : PAGE_SIZE * a->page_cnt - sizeof *a;
+}
+
+/* Attempts to resize OLD_BLOCK to NEW_SIZE bytes, possibly
+   moving it in the process.
+   If successful, returns the new block; on failure, returns a
+   null pointer.
+   A call with null OLD_BLOCK is equivalent to malloc(NEW_SIZE).
+   A call with zero NEW_SIZE is equivalent to free(OLD_BLOCK). */
+void *
+realloc (void *old_block, size_t new_size)
+{
+  if (new_size == 0)
+    {
+      free (old_block);
+      return NULL;
+    }
+  else if (old_block != NULL && new_size <= block_size (old_block))
+    return old_block;
+  else
+    {
+      void *new_block = malloc (new_size);
+      if (old_block != NULL && new_block != NULL)
+        {
+          memcpy (new_block, old_block, block_size (old_block));
+          free (old_block);
+        }
+      return new_block;
+    }
+}
+
+/* Frees block P, which must have been previously allocated with
+   malloc(), calloc(), or realloc(). */
+void
+free (void *p)
+{
+  if (p != NULL)
+    {
+      struct block *b = p;
+      struct arena *a = block_to_arena (b);
+      struct desc *d = a->desc;
+
+      if (d != NULL)
+        {
+          /* It's a normal block.  Add it to its free list. */
+#ifndef NDEBUG
+          /* Clear the block to help detect use-after-free bugs. */
+          memset (b, 0xcc, d->block_size);
+#endif
+          b->next = d->free_list;
+          d->free_list = b;
+        }
+      else
+        {
+          /* It's a big block.  Free its pages. */
+          free_run (a);
+        }
+    }
+}
+
+/* Returns the arena that block B is inside. */
+static struct arena *
+block_to_arena (struct block *b)
+{
+  struct arena *a = (struct arena *) ROUND_DOWN ((uintptr_t) b, PAGE_SIZE);
+
+  /* Check that the arena is valid. */
+  ASSERT (a != NULL);
+  ASSERT (a->magic == ARENA_MAGIC);
+
+  /* Check that the block is properly aligned for the arena. */
+  ASSERT (a->desc == NULL
+          || ((uintptr_t) b % PAGE_SIZE - sizeof *a)
+             % a->desc->block_size == 0);
+  ASSERT (a->desc != NULL || (uintptr_t) b % PAGE_SIZE == sizeof *a);
+
+  return a;
+}
+
+/* Returns the (IDX - 1)'th block within arena A. */
+static struct block *
+arena_to_block (struct arena *a, size_t idx)
+{
+  ASSERT (a != NULL);
+  ASSERT (a->magic == ARENA_MAGIC);
+  ASSERT (idx < a->desc->blocks_per_arena);
+  return (struct block *) ((uint8_t *) a
+                           + sizeof *a
+                           + idx * a->desc->block_size);
+}
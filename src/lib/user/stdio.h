@@ -1,6 +1,23 @@
 #ifndef __LIB_USER_STDIO_H
 #define __LIB_USER_STDIO_H
 
+/* Buffered output streams. */
+typedef struct FILE FILE;
+extern FILE *stdout;
+
+#define BUFSIZ 512              /* Size of a stream's buffer. */
+#define FOPEN_MAX 16            /* Maximum number of open streams. */
+#define EOF (-1)                /* Returned on error. */
+
+FILE *fdopen (int fd);
+int fclose (FILE *);
+int fflush (FILE *);
+size_t fwrite (const void *, size_t size, size_t cnt, FILE *);
+int fputc (int, FILE *);
+int fputs (const char *, FILE *);
+int fprintf (FILE *, const char *, ...) PRINTF_FORMAT (2, 3);
+int vfprintf (FILE *, const char *, va_list) PRINTF_FORMAT (2, 0);
+
 int hprintf (int, const char *, ...) PRINTF_FORMAT (2, 3);
 int vhprintf (int, const char *, va_list) PRINTF_FORMAT (2, 0);
 
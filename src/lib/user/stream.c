@@ -0,0 +1,174 @@
+#include <stdio.h>
+#include <string.h>
+#include <syscall.h>
+
+/* Buffered output streams.
+
+   Output to a stream collects in its buffer and goes to its file
+   descriptor in a single write system call when the buffer fills
+   up, when fflush() is called, or when the process exits.  The
+   console stream, stdout, is also flushed at the end of each
+   line, and before reading from the console, so that output
+   appears as promptly as without buffering but with one system
+   call per line rather than per character or per printf()
+   fragment.
+
+   Output written with write() directly bypasses the buffers, so
+   mixing it with stream output requires fflush() first. */
+
+/* A buffered output stream. */
+struct FILE
+  {
+    bool in_use;                /* Is this stream open? */
+    bool line_buffered;         /* Flush at the end of each line? */
+    int fd;                     /* File descriptor. */
+    size_t cnt;                 /* Number of bytes in BUF. */
+    char buf[BUFSIZ];           /* Buffered output. */
+  };
+
+/* All the streams that may be open at once.  There is no
+   malloc() in user programs, so they are allocated statically. */
+static FILE streams[FOPEN_MAX] =
+  {
+    {true, true, STDOUT_FILENO, 0, {0}},
+  };
+
+/* The console. */
+FILE *stdout = &streams[0];
+
+/* Opens a stream for output to file descriptor FD, which is line
+   buffered if FD is the console and fully buffered otherwise.
+   Returns the new stream, or a null pointer if FOPEN_MAX streams
+   are already open. */
+FILE *
+fdopen (int fd)
+{
+  FILE *stream;
+
+  for (stream = streams; stream < streams + FOPEN_MAX; stream++)
+    if (!stream->in_use)
+      {
+        stream->in_use = true;
+        stream->line_buffered = fd == STDOUT_FILENO;
+        stream->fd = fd;
+        stream->cnt = 0;
+        return stream;
+      }
+  return NULL;
+}
+
+/* Flushes STREAM and closes it, along with its file descriptor
+   unless that is the console.  Returns 0 if successful, EOF if
+   the flush failed. */
+int
+fclose (FILE *stream)
+{
+  int retval = fflush (stream);
+
+  if (stream->fd != STDOUT_FILENO)
+    close (stream->fd);
+  stream->in_use = false;
+  return retval;
+}
+
+/* Writes the data buffered in STREAM, or in every open stream if
+   STREAM is a null pointer.  Returns 0 if successful, EOF if a
+   write failed. */
+int
+fflush (FILE *stream)
+{
+  int retval = 0;
+
+  if (stream == NULL)
+    {
+      for (stream = streams; stream < streams + FOPEN_MAX; stream++)
+        if (stream->in_use && fflush (stream) == EOF)
+          retval = EOF;
+    }
+  else if (stream->cnt > 0)
+    {
+      if (write (stream->fd, stream->buf, stream->cnt) != (int) stream->cnt)
+        retval = EOF;
+      stream->cnt = 0;
+    }
+  return retval;
+}
+
+/* Writes CNT elements of SIZE bytes each from BUFFER to STREAM.
+   Returns CNT if successful, 0 if a write failed. */
+size_t
+fwrite (const void *buffer, size_t size, size_t cnt, FILE *stream)
+{
+  size_t n = size * cnt;
+
+  if (stream->cnt + n > BUFSIZ && fflush (stream) == EOF)
+    return 0;
+  if (n >= BUFSIZ)
+    return write (stream->fd, buffer, n) == (int) n ? cnt : 0;
+
+  memcpy (stream->buf + stream->cnt, buffer, n);
+  stream->cnt += n;
+  if (stream->line_buffered && memchr (buffer, '\n', n) != NULL
+      && fflush (stream) == EOF)
+    return 0;
+  return cnt;
+}
+
+/* Writes C to STREAM.  Returns C if successful, EOF if a write
+   failed. */
+int
+fputc (int c, FILE *stream)
+{
+  unsigned char c2 = c;
+  return fwrite (&c2, 1, 1, stream) == 1 ? c2 : EOF;
+}
+
+/* Writes string S to STREAM, without a new-line character.
+   Returns 0 if successful, EOF if a write failed. */
+int
+fputs (const char *s, FILE *stream)
+{
+  size_t len = strlen (s);
+  return len == 0 || fwrite (s, len, 1, stream) == 1 ? 0 : EOF;
+}
+
+/* Like printf(), but writes output to STREAM. */
+int
+fprintf (FILE *stream, const char *format, ...)
+{
+  va_list args;
+  int retval;
+
+  va_start (args, format);
+  retval = vfprintf (stream, format, args);
+  va_end (args);
+
+  return retval;
+}
+
+/* Auxiliary data for vfprintf_helper(). */
+struct vfprintf_aux
+  {
+    FILE *stream;       /* Output stream. */
+    int char_cnt;       /* Total characters written so far. */
+  };
+
+/* Writes C to the stream in AUX. */
+static void
+vfprintf_helper (char c, void *aux_)
+{
+  struct vfprintf_aux *aux = aux_;
+  fputc (c, aux->stream);
+  aux->char_cnt++;
+}
+
+/* Like vprintf(), but writes output to STREAM. */
+int
+vfprintf (FILE *stream, const char *format, va_list args)
+{
+  struct vfprintf_aux aux;
+  aux.stream = stream;
+  aux.char_cnt = 0;
+  __vprintf (format, args, vfprintf_helper, &aux);
+  return aux.char_cnt;
+}
@@ -1,9 +1,10 @@
 #include <syscall.h>
+#include <stdio.h>
 #include "../syscall-nr.h"
 
-/* Invokes syscall NUMBER, passing no arguments, and returns the
-   return value as an `int'. */
-#define syscall0(NUMBER)                                        \
+/* Invokes syscall NUMBER with "int $0x30", passing no arguments,
+   and returns the return value as an `int'. */
+#define int_syscall0(NUMBER)                                        \
         ({                                                      \
           int retval;                                           \
           asm volatile                                          \
@@ -14,9 +15,9 @@
           retval;                                               \
         })
 
-/* Invokes syscall NUMBER, passing argument ARG0, and returns the
-   return value as an `int'. */
-#define syscall1(NUMBER, ARG0)                                           \
+/* Invokes syscall NUMBER with "int $0x30", passing argument ARG0,
+   and returns the return value as an `int'. */
+#define int_syscall1(NUMBER, ARG0)                                           \
         ({                                                               \
           int retval;                                                    \
           asm volatile                                                   \
@@ -28,9 +29,9 @@
           retval;                                                        \
         })
 
-/* Invokes syscall NUMBER, passing arguments ARG0 and ARG1, and
-   returns the return value as an `int'. */
-#define syscall2(NUMBER, ARG0, ARG1)                            \
+/* Invokes syscall NUMBER with "int $0x30", passing arguments ARG0
+   and ARG1, and returns the return value as an `int'. */
+#define int_syscall2(NUMBER, ARG0, ARG1)                            \
         ({                                                      \
           int retval;                                           \
           asm volatile                                          \
@@ -44,9 +45,10 @@
           retval;                                               \
         })
 
-/* Invokes syscall NUMBER, passing arguments ARG0, ARG1, and
-   ARG2, and returns the return value as an `int'. */
-#define syscall3(NUMBER, ARG0, ARG1, ARG2)                      \
+/* Invokes syscall NUMBER with "int $0x30", passing arguments
+   ARG0, ARG1, and ARG2, and returns the return value as an
+   `int'. */
+#define int_syscall3(NUMBER, ARG0, ARG1, ARG2)                      \
         ({                                                      \
           int retval;                                           \
           asm volatile                                          \
@@ -61,9 +63,105 @@
           retval;                                               \
         })
 
+/* Invokes syscall NUMBER with "int $0x30", passing arguments
+   ARG0, ARG1, ARG2, and ARG3, and returns the return value as an
+   `int'. */
+#define int_syscall4(NUMBER, ARG0, ARG1, ARG2, ARG3)            \
+        ({                                                      \
+          int retval;                                           \
+          asm volatile                                          \
+            ("pushl %[arg3]; pushl %[arg2]; pushl %[arg1]; "    \
+             "pushl %[arg0]; pushl %[number]; int $0x30; "      \
+             "addl $20, %%esp"                                  \
+               : "=a" (retval)                                  \
+               : [number] "i" (NUMBER),                         \
+                 [arg0] "r" (ARG0),                             \
+                 [arg1] "r" (ARG1),                             \
+                 [arg2] "r" (ARG2),                             \
+                 [arg3] "r" (ARG3)                              \
+               : "memory");                                     \
+          retval;                                               \
+        })
+
+/* Invokes syscall NUMBER with SYSENTER, passing arguments ARG0,
+   ARG1, and ARG2 in registers, and returns the return value as
+   an `int'.  This is faster than "int $0x30", but older CPUs
+   lack it.  See userprog/sysenter.S for the protocol. */
+#define sysenter_syscall(NUMBER, ARG0, ARG1, ARG2)              \
+        ({                                                      \
+          int retval;                                           \
+          asm volatile                                          \
+            ("movl %%esp, %%ecx; movl $1f, %%edx; sysenter; 1:" \
+               : "=a" (retval)                                  \
+               : "a" (NUMBER),                                  \
+                 "b" (ARG0),                                    \
+                 "S" (ARG1),                                    \
+                 "D" (ARG2)                                     \
+               : "ecx", "edx", "cc", "memory");                 \
+          retval;                                               \
+        })
+
+/* Like sysenter_syscall(), but also passes ARG3, which does not
+   fit in a register, on top of the user stack. */
+#define sysenter_syscall4(NUMBER, ARG0, ARG1, ARG2, ARG3)       \
+        ({                                                      \
+          int retval;                                           \
+          asm volatile                                          \
+            ("pushl %[arg3]; movl %%esp, %%ecx; "               \
+             "movl $1f, %%edx; sysenter; 1: addl $4, %%esp"     \
+               : "=a" (retval)                                  \
+               : "a" (NUMBER),                                  \
+                 "b" (ARG0),                                    \
+                 "S" (ARG1),                                    \
+                 "D" (ARG2),                                    \
+                 [arg3] "g" (ARG3)                              \
+               : "ecx", "edx", "cc", "memory");                 \
+          retval;                                               \
+        })
+
+/* Returns true if the CPU supports SYSENTER. */
+static bool
+has_sysenter (void)
+{
+  static int has = -1;
+
+  if (has < 0)
+    {
+      unsigned eax = 1, ebx, ecx, edx;
+      asm ("cpuid" : "+a" (eax), "=b" (ebx), "=c" (ecx), "=d" (edx));
+      has = (edx & 0x800) != 0;
+    }
+  return has;
+}
+
+/* Invoke syscall NUMBER, passing the arguments given, with
+   SYSENTER if possible or "int $0x30" otherwise, and return the
+   return value as an `int'. */
+#define syscall0(NUMBER)                                        \
+        (has_sysenter ()                                        \
+         ? sysenter_syscall (NUMBER, 0, 0, 0)                   \
+         : int_syscall0 (NUMBER))
+#define syscall1(NUMBER, ARG0)                                  \
+        (has_sysenter ()                                        \
+         ? sysenter_syscall (NUMBER, ARG0, 0, 0)                \
+         : int_syscall1 (NUMBER, ARG0))
+#define syscall2(NUMBER, ARG0, ARG1)                            \
+        (has_sysenter ()                                        \
+         ? sysenter_syscall (NUMBER, ARG0, ARG1, 0)             \
+         : int_syscall2 (NUMBER, ARG0, ARG1))
+#define syscall3(NUMBER, ARG0, ARG1, ARG2)                      \
+        (has_sysenter ()                                        \
+         ? sysenter_syscall (NUMBER, ARG0, ARG1, ARG2)          \
+         : int_syscall3 (NUMBER, ARG0, ARG1, ARG2))
+#define syscall4(NUMBER, ARG0, ARG1, ARG2, ARG3)                \
+        (has_sysenter ()                                        \
+         ? sysenter_syscall4 (NUMBER, ARG0, ARG1, ARG2, ARG3)   \
+         : int_syscall4 (NUMBER, ARG0, ARG1, ARG2, ARG3))
+
 void
 halt (void) 
 {
+  fflush (NULL);
   syscall0 (SYS_HALT);
   NOT_REACHED ();
 }
@@ -71,6 +169,7 @@ halt (void)
 void
 exit (int status)
 {
+  fflush (NULL);
   syscall1 (SYS_EXIT, status);
   NOT_REACHED ();
 }
@@ -87,6 +186,12 @@ wait (pid_t pid)
   return syscall1 (SYS_WAIT, pid);
 }
 
+pid_t
+waitpid (pid_t pid, int *status, int options)
+{
+  return (pid_t) syscall3 (SYS_WAITPID, pid, status, options);
+}
+
 bool
 create (const char *file, unsigned initial_size)
 {
@@ -114,6 +219,9 @@ filesize (int fd)
 int
 read (int fd, void *buffer, unsigned size)
 {
+  /* Make sure a prompt is visible before waiting for input. */
+  if (fd == STDIN_FILENO)
+    fflush (stdout);
   return syscall3 (SYS_READ, fd, buffer, size);
 }
 
@@ -182,3 +290,53 @@ inumber (int fd)
 {
   return syscall1 (SYS_INUMBER, fd);
 }
+
+pid_t
+fork (void)
+{
+  /* Otherwise both processes would write the buffered output. */
+  fflush (NULL);
+  return (pid_t) syscall0 (SYS_FORK);
+}
+
+void
+memstat (struct memstat *m)
+{
+  syscall1 (SYS_MEMSTAT, m);
+}
+
+int
+readv (int fd, const struct iovec *iov, int iovcnt)
+{
+  return syscall3 (SYS_READV, fd, iov, iovcnt);
+}
+
+int
+writev (int fd, const struct iovec *iov, int iovcnt)
+{
+  return syscall3 (SYS_WRITEV, fd, iov, iovcnt);
+}
+
+int
+pread (int fd, void *buffer, unsigned size, unsigned offset)
+{
+  return syscall4 (SYS_PREAD, fd, buffer, size, offset);
+}
+
+int
+pwrite (int fd, const void *buffer, unsigned size, unsigned offset)
+{
+  return syscall4 (SYS_PWRITE, fd, buffer, size, offset);
+}
+
+int
+ring_enter (struct ring *ring, unsigned to_submit)
+{
+  return syscall2 (SYS_ENTER_RING, ring, to_submit);
+}
+
+void *
+sbrk (intptr_t increment)
+{
+  return (void *) syscall1 (SYS_SBRK, increment);
+}
@@ -2,7 +2,12 @@
 #define __LIB_USER_SYSCALL_H
 
 #include <stdbool.h>
+#include <stdint.h>
 #include <debug.h>
+#include <iovec.h>
+#include <memstat.h>
+#include <ring.h>
+#include <wait.h>
 
 /* Process identifier. */
 typedef int pid_t;
@@ -45,4 +50,15 @@ bool readdir (int fd, char name[READDIR_MAX_LEN + 1]);
 bool isdir (int fd);
 int inumber (int fd);
 
+/* Extensions. */
+pid_t fork (void);
+void memstat (struct memstat *);
+int readv (int fd, const struct iovec *, int iovcnt);
+int writev (int fd, const struct iovec *, int iovcnt);
+int pread (int fd, void *buffer, unsigned length, unsigned offset);
+int pwrite (int fd, const void *buffer, unsigned length, unsigned offset);
+int ring_enter (struct ring *, unsigned to_submit);
+void *sbrk (intptr_t increment);
+pid_t waitpid (pid_t, int *status, int options);
+
 #endif /* lib/user/syscall.h */
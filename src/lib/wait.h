@@ -0,0 +1,11 @@
+#ifndef __LIB_WAIT_H
+#define __LIB_WAIT_H
+
+/* Passed to the waitpid system call in place of a process
+   identifier, to wait for whichever child exits first. */
+#define WAIT_ANY (-1)
+
+/* Options for the waitpid system call. */
+#define WNOHANG 1               /* Return 0 if no child has exited yet. */
+
+#endif /* lib/wait.h */
@@ -0,0 +1,11 @@
+/* Child process run by the wait-any test.
+   Exits with the status given as its argument, without printing
+   anything, so that several can run at once. */
+
+#include <stdlib.h>
+
+int
+main (int argc, char *argv[]) 
+{
+  return argc > 1 ? atoi (argv[1]) : 0;
+}
@@ -0,0 +1,41 @@
+/* Executes a child process, then overwrites the start of its
+   executable and tries to execute it again, which must fail.
+   Then restores the executable and executes it once more.  The
+   kernel must notice each change to the executable instead of
+   reusing headers it read earlier. */
+
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+static const char child[] = "child-simple";
+
+/* Overwrites the first sizeof HEADER bytes of the child's
+   executable with HEADER. */
+static void
+rewrite (const char header[8])
+{
+  int fd;
+
+  CHECK ((fd = open (child)) > 1, "open \"%s\"", child);
+  CHECK (write (fd, header, 8) == 8, "write \"%s\"", child);
+  close (fd);
+}
+
+void
+test_main (void)
+{
+  char header[8];
+  int fd;
+
+  CHECK ((fd = open (child)) > 1, "open \"%s\"", child);
+  CHECK (read (fd, header, sizeof header) == sizeof header,
+         "read \"%s\"", child);
+  close (fd);
+
+  CHECK (wait (exec (child)) == 81, "exec \"%s\"", child);
+  rewrite ("garbage!");
+  CHECK (exec (child) == -1, "exec rewritten \"%s\"", child);
+  rewrite (header);
+  CHECK (wait (exec (child)) == 81, "exec restored \"%s\"", child);
+}
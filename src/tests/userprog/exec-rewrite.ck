@@ -0,0 +1,24 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(exec-rewrite) begin
+(exec-rewrite) open "child-simple"
+(exec-rewrite) read "child-simple"
+(child-simple) run
+child-simple: exit(81)
+(exec-rewrite) exec "child-simple"
+(exec-rewrite) open "child-simple"
+(exec-rewrite) write "child-simple"
+load: child-simple: error loading executable
+(exec-rewrite) exec rewritten "child-simple"
+(exec-rewrite) open "child-simple"
+(exec-rewrite) write "child-simple"
+(child-simple) run
+child-simple: exit(81)
+(exec-rewrite) exec restored "child-simple"
+(exec-rewrite) end
+exec-rewrite: exit(0)
+EOF
+pass;
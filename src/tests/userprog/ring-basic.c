@@ -0,0 +1,74 @@
+/* Creates and writes a file through the system call ring,
+   several requests per ring_enter() call, and checks the
+   completions and the file's contents. */
+
+#include <string.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+static struct ring ring;
+static char data[] = "one two three";
+
+/* Queues a request for operation OP with the given arguments,
+   tagged with USER_DATA. */
+static void
+queue (int op, int fd, void *buf, unsigned len, unsigned user_data)
+{
+  struct ring_sqe *sqe = &ring.sq.entries[ring.sq.tail++ % RING_SIZE];
+  sqe->op = op;
+  sqe->fd = fd;
+  sqe->buf = buf;
+  sqe->len = len;
+  sqe->user_data = user_data;
+}
+
+/* Submits the queued requests, which must number CNT, and checks
+   that they were all carried out. */
+static void
+submit (unsigned cnt)
+{
+  int done = ring_enter (&ring, cnt);
+  if (done != (int) cnt)
+    fail ("ring_enter carried out %d of %u requests", done, cnt);
+}
+
+/* Collects the next completion, checking that it is tagged with
+   USER_DATA, and returns its result. */
+static int
+reap (unsigned user_data)
+{
+  struct ring_cqe *cqe;
+
+  if (ring.cq.head == ring.cq.tail)
+    fail ("completion ring is empty");
+  cqe = &ring.cq.entries[ring.cq.head++ % RING_SIZE];
+  if (cqe->user_data != user_data)
+    fail ("completion for request %u, expected %u",
+          cqe->user_data, user_data);
+  return cqe->result;
+}
+
+void
+test_main (void)
+{
+  int fd;
+
+  queue (RING_OP_CREATE, 0, "ring-file", 0, 1);
+  queue (RING_OP_OPEN, 0, "ring-file", 0, 2);
+  submit (2);
+  CHECK (reap (1), "create \"ring-file\"");
+  CHECK ((fd = reap (2)) > 1, "open \"ring-file\"");
+
+  queue (RING_OP_WRITE, fd, data, 4, 3);
+  queue (RING_OP_WRITE, fd, data + 4, 4, 4);
+  queue (RING_OP_WRITE, fd, data + 8, sizeof data - 9, 5);
+  queue (RING_OP_CLOSE, fd, NULL, 0, 6);
+  submit (4);
+  CHECK (reap (3) == 4, "write \"one \"");
+  CHECK (reap (4) == 4, "write \"two \"");
+  CHECK (reap (5) == sizeof data - 9, "write \"three\"");
+  CHECK (reap (6) == 0, "close \"ring-file\"");
+
+  check_file ("ring-file", data, sizeof data - 1);
+}
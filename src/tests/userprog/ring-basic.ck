@@ -0,0 +1,19 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(ring-basic) begin
+(ring-basic) create "ring-file"
+(ring-basic) open "ring-file"
+(ring-basic) write "one "
+(ring-basic) write "two "
+(ring-basic) write "three"
+(ring-basic) close "ring-file"
+(ring-basic) open "ring-file" for verification
+(ring-basic) verified contents of "ring-file"
+(ring-basic) close "ring-file"
+(ring-basic) end
+ring-basic: exit(0)
+EOF
+pass;
@@ -0,0 +1,53 @@
+/* Writes a record made of a header and a payload with one
+   writev(), rewrites part of it in place with pwrite(), and reads
+   it back with readv() and pread(), checking that pread() and
+   pwrite() leave the file position alone. */
+
+#include <string.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+static char header[] = "HEADER: ";
+static char payload[] = "the quick brown fox";
+
+void
+test_main (void)
+{
+  char head[sizeof header - 1], body[sizeof payload - 1];
+  char expected[sizeof payload - 1];
+  struct iovec iov[2];
+  int fd;
+
+  CHECK (create ("record", 0), "create \"record\"");
+  CHECK ((fd = open ("record")) > 1, "open \"record\"");
+
+  iov[0].iov_base = header;
+  iov[0].iov_len = sizeof header - 1;
+  iov[1].iov_base = payload;
+  iov[1].iov_len = sizeof payload - 1;
+  CHECK (writev (fd, iov, 2) == sizeof header + sizeof payload - 2,
+         "writev header and payload");
+
+  CHECK (pwrite (fd, "slow", 4, sizeof header - 1 + 4) == 4,
+         "pwrite into payload");
+  if (tell (fd) != sizeof header + sizeof payload - 2)
+    fail ("pwrite moved file position to %u", tell (fd));
+
+  seek (fd, 0);
+  iov[0].iov_base = head;
+  iov[1].iov_base = body;
+  CHECK (readv (fd, iov, 2) == sizeof header + sizeof payload - 2,
+         "readv header and payload");
+  memcpy (expected, payload, sizeof expected);
+  memcpy (expected + 4, "slow", 4);
+  compare_bytes (head, header, sizeof head, 0, "record");
+  compare_bytes (body, expected, sizeof body, sizeof head, "record");
+
+  seek (fd, 0);
+  CHECK (pread (fd, body, sizeof body, sizeof head) == sizeof body,
+         "pread payload");
+  compare_bytes (body, expected, sizeof body, sizeof head, "record");
+  if (tell (fd) != 0)
+    fail ("pread moved file position to %u", tell (fd));
+}
@@ -0,0 +1,16 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(rw-vector) begin
+(rw-vector) create "record"
+(rw-vector) open "record"
+(rw-vector) writev header and payload
+(rw-vector) pwrite into payload
+(rw-vector) readv header and payload
+(rw-vector) pread payload
+(rw-vector) end
+rw-vector: exit(0)
+EOF
+pass;
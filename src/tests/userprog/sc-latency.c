@@ -0,0 +1,69 @@
+/* Measures the latency of tell(), about the cheapest system
+   call there is, made with "int $0x30" and through the system
+   call library, which uses SYSENTER if the CPU supports it, and
+   checks that both give the same result.  Times are in CPU
+   cycles, as counted by RDTSC. */
+
+#include <syscall.h>
+#include <syscall-nr.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+/* Number of calls to time each way. */
+#define CALL_CNT 1000
+
+/* Returns the CPU's time-stamp counter. */
+static inline unsigned long long
+rdtsc (void)
+{
+  unsigned long long tsc;
+  asm volatile ("rdtsc" : "=A" (tsc));
+  return tsc;
+}
+
+/* Calls tell(FD) with "int $0x30". */
+static unsigned
+int_tell (int fd)
+{
+  unsigned retval;
+  asm volatile ("pushl %[fd]; pushl %[number]; int $0x30; addl $8, %%esp"
+                : "=a" (retval)
+                : [number] "i" (SYS_TELL), [fd] "r" (fd)
+                : "memory");
+  return retval;
+}
+
+/* Calls tell(FD) through the system call library. */
+static unsigned
+lib_tell (int fd)
+{
+  return tell (fd);
+}
+
+/* Returns the average number of cycles taken by CALL(FD). */
+static unsigned long long
+time_calls (unsigned (*call) (int), int fd)
+{
+  unsigned long long start = rdtsc ();
+  int i;
+
+  for (i = 0; i < CALL_CNT; i++)
+    call (fd);
+  return (rdtsc () - start) / CALL_CNT;
+}
+
+void
+test_main (void)
+{
+  int fd;
+
+  CHECK ((fd = open ("sample.txt")) > 1, "open \"sample.txt\"");
+  seek (fd, 42);
+  if (int_tell (fd) != 42)
+    fail ("tell() with \"int $0x30\" returned %u", int_tell (fd));
+  if (lib_tell (fd) != 42)
+    fail ("tell() through library returned %u", lib_tell (fd));
+
+  msg ("int $0x30: %llu cycles", time_calls (int_tell, fd));
+  msg ("library: %llu cycles", time_calls (lib_tell, fd));
+}
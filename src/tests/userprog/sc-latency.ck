@@ -0,0 +1,17 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+our ($test);
+my (@output) = read_text_file ("$test.output");
+common_checks ("run", @output);
+s/: \d+ cycles$/: N cycles/ foreach @output;
+compare_output ("run", \@output, [<<'EOF']);
+(sc-latency) begin
+(sc-latency) open "sample.txt"
+(sc-latency) int $0x30: N cycles
+(sc-latency) library: N cycles
+(sc-latency) end
+sc-latency: exit(0)
+EOF
+pass;
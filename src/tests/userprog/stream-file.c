@@ -0,0 +1,36 @@
+/* Writes lines to a file through a buffered stream, checking
+   that nothing reaches the file until the stream is flushed, and
+   then that everything does. */
+
+#include <stdio.h>
+#include <string.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+void
+test_main (void)
+{
+  char buf[64];
+  FILE *stream;
+  int fd, i;
+
+  CHECK (create ("lines", 0), "create \"lines\"");
+  CHECK ((fd = open ("lines")) > 1, "open \"lines\"");
+  CHECK ((stream = fdopen (fd)) != NULL, "fdopen \"lines\"");
+
+  for (i = 0; i < 4; i++)
+    fprintf (stream, "line %d\n", i);
+  CHECK (filesize (fd) == 0, "file is empty before flush");
+  CHECK (fflush (stream) == 0, "fflush");
+  CHECK (filesize (fd) == 28, "file has 28 bytes after flush");
+
+  fputs ("tail", stream);
+  CHECK (fclose (stream) == 0, "fclose");
+
+  CHECK ((fd = open ("lines")) > 1, "open \"lines\" again");
+  CHECK (read (fd, buf, sizeof buf) == 32, "read \"lines\"");
+  if (memcmp (buf, "line 0\nline 1\nline 2\nline 3\ntail", 32))
+    fail ("file contents differ");
+  close (fd);
+}
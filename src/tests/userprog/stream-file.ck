@@ -0,0 +1,19 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(stream-file) begin
+(stream-file) create "lines"
+(stream-file) open "lines"
+(stream-file) fdopen "lines"
+(stream-file) file is empty before flush
+(stream-file) fflush
+(stream-file) file has 28 bytes after flush
+(stream-file) fclose
+(stream-file) open "lines" again
+(stream-file) read "lines"
+(stream-file) end
+stream-file: exit(0)
+EOF
+pass;
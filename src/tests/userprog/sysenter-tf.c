@@ -0,0 +1,39 @@
+/* Enters a system call with SYSENTER, as the system call library
+   does, with the trap flag set in EFLAGS.  SYSENTER does not
+   clear the trap flag, so the kernel takes a single-step trap in
+   its SYSENTER entry point, which must not panic it.  The flag
+   has to be set by the instruction just before SYSENTER, or the
+   process would trap in user mode first.  On a CPU without
+   SYSENTER, the message is written with the library instead. */
+
+#include <stdio.h>
+#include <string.h>
+#include <syscall.h>
+#include <syscall-nr.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+void
+test_main (void) 
+{
+  static const char message[] = "(sysenter-tf) write with TF set\n";
+  unsigned eax = 1, ebx, ecx, edx;
+  int retval;
+
+  asm ("cpuid" : "+a" (eax), "=b" (ebx), "=c" (ecx), "=d" (edx));
+  if ((edx & 0x800) == 0)
+    retval = write (STDOUT_FILENO, message, strlen (message));
+  else
+    asm volatile
+      ("pushfl; orl $0x100, (%%esp); "
+       "leal 4(%%esp), %%ecx; movl $1f, %%edx; "
+       "popfl; sysenter; 1:"
+         : "=a" (retval)
+         : "a" (SYS_WRITE),
+           "b" (STDOUT_FILENO),
+           "S" (message),
+           "D" (strlen (message))
+         : "ecx", "edx", "cc", "memory");
+  if (retval != (int) strlen (message))
+    fail ("write returned %d", retval);
+}
@@ -0,0 +1,11 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(sysenter-tf) begin
+(sysenter-tf) write with TF set
+(sysenter-tf) end
+sysenter-tf: exit(0)
+EOF
+pass;
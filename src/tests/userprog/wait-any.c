@@ -0,0 +1,50 @@
+/* Starts several children and reaps them with waitpid() in
+   whatever order they exit, then polls for another child with
+   WNOHANG until it exits. */
+
+#include <stdio.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define CHILD_CNT 4
+
+void
+test_main (void) 
+{
+  pid_t pids[CHILD_CNT], pid;
+  bool reaped[CHILD_CNT];
+  int status;
+  int i, j;
+
+  for (i = 0; i < CHILD_CNT; i++)
+    {
+      char cmd_line[32];
+      snprintf (cmd_line, sizeof cmd_line, "child-exit %d", i);
+      CHECK ((pids[i] = exec (cmd_line)) != PID_ERROR, "exec \"%s\"", cmd_line);
+      reaped[i] = false;
+    }
+
+  for (i = 0; i < CHILD_CNT; i++)
+    {
+      pid = waitpid (WAIT_ANY, &status, 0);
+      for (j = 0; j < CHILD_CNT; j++)
+        if (pids[j] == pid)
+          break;
+      if (j == CHILD_CNT || reaped[j])
+        fail ("waitpid returned unexpected pid %d", pid);
+      if (status != j)
+        fail ("child %d exited with %d", j, status);
+      reaped[j] = true;
+      msg ("wait for any child");
+    }
+  CHECK (waitpid (WAIT_ANY, &status, 0) == -1, "wait with no children");
+  CHECK (waitpid (pids[0], &status, WNOHANG) == -1, "poll reaped child");
+
+  CHECK ((pids[0] = exec ("child-exit 42")) != PID_ERROR,
+         "exec \"child-exit 42\"");
+  while ((pid = waitpid (pids[0], &status, WNOHANG)) == 0)
+    continue;
+  CHECK (pid == pids[0] && status == 42, "poll for child");
+  CHECK (waitpid (WAIT_ANY, &status, WNOHANG) == -1, "poll with no children");
+}
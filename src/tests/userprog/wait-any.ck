@@ -0,0 +1,22 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected (IGNORE_EXIT_CODES => 1, [<<'EOF']);
+(wait-any) begin
+(wait-any) exec "child-exit 0"
+(wait-any) exec "child-exit 1"
+(wait-any) exec "child-exit 2"
+(wait-any) exec "child-exit 3"
+(wait-any) wait for any child
+(wait-any) wait for any child
+(wait-any) wait for any child
+(wait-any) wait for any child
+(wait-any) wait with no children
+(wait-any) poll reaped child
+(wait-any) exec "child-exit 42"
+(wait-any) poll for child
+(wait-any) poll with no children
+(wait-any) end
+EOF
+pass;
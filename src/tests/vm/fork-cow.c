@@ -0,0 +1,44 @@
+/* Forks a child that modifies memory that it shares with its
+   parent, and verifies that each process sees only its own
+   writes. */
+
+#include <string.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define SIZE (64 * 1024)
+
+static char buf[SIZE];
+
+void
+test_main (void)
+{
+  pid_t child;
+  size_t i;
+
+  memset (buf, 0x5a, sizeof buf);
+
+  child = fork ();
+  if (child == 0)
+    {
+      /* Child: still sees the parent's data, then overwrites
+         it. */
+      for (i = 0; i < SIZE; i++)
+        if (buf[i] != 0x5a)
+          exit (1);
+      memset (buf, 0xa5, sizeof buf);
+      for (i = 0; i < SIZE; i++)
+        if (buf[i] != (char) 0xa5)
+          exit (2);
+      exit (81);
+    }
+  CHECK (child != -1, "fork");
+
+  CHECK (wait (child) == 81, "wait for child");
+
+  msg ("check parent's memory");
+  for (i = 0; i < SIZE; i++)
+    if (buf[i] != 0x5a)
+      fail ("byte %zu != 0x5a", i);
+}
@@ -0,0 +1,75 @@
+/* Allocates blocks of many sizes with malloc(), some of them
+   bigger than a page, fills each with its own pattern, and
+   checks the patterns after freeing half of the blocks and
+   growing the rest with realloc().  Then checks that freeing a
+   big block at the end of the heap gives its pages back. */
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define BLOCK_CNT 500
+
+static uint8_t *blocks[BLOCK_CNT];
+
+/* Returns the size of block I when first allocated. */
+static size_t
+block_size (int i)
+{
+  return (size_t) (i % 50 == 0 ? 5000 + i * 10 : i * 7 % 300 + 1);
+}
+
+/* Checks that the first SIZE bytes of block I hold its pattern. */
+static void
+check_block (int i, size_t size)
+{
+  size_t j;
+
+  for (j = 0; j < size; j++)
+    if (blocks[i][j] != (uint8_t) i)
+      fail ("block %d byte %zu is %d", i, j, blocks[i][j]);
+}
+
+void
+test_main (void)
+{
+  uint8_t *brk;
+  void *big;
+  int i;
+
+  msg ("allocate");
+  for (i = 0; i < BLOCK_CNT; i++)
+    {
+      blocks[i] = malloc (block_size (i));
+      if (blocks[i] == NULL)
+        fail ("malloc of block %d failed", i);
+      memset (blocks[i], i, block_size (i));
+    }
+
+  msg ("free odd blocks");
+  for (i = 0; i < BLOCK_CNT; i++)
+    check_block (i, block_size (i));
+  for (i = 1; i < BLOCK_CNT; i += 2)
+    free (blocks[i]);
+
+  msg ("grow even blocks");
+  for (i = 0; i < BLOCK_CNT; i += 2)
+    {
+      check_block (i, block_size (i));
+      blocks[i] = realloc (blocks[i], block_size (i) * 2);
+      if (blocks[i] == NULL)
+        fail ("realloc of block %d failed", i);
+      check_block (i, block_size (i));
+    }
+  for (i = 0; i < BLOCK_CNT; i += 2)
+    free (blocks[i]);
+
+  brk = sbrk (0);
+  CHECK ((big = malloc (64 * 1024)) != NULL, "malloc 64 kB");
+  CHECK ((uint8_t *) sbrk (0) > brk, "heap grew");
+  free (big);
+  CHECK (sbrk (0) == brk, "free gave the pages back");
+}
@@ -0,0 +1,16 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(heap-malloc) begin
+(heap-malloc) allocate
+(heap-malloc) free odd blocks
+(heap-malloc) grow even blocks
+(heap-malloc) malloc 64 kB
+(heap-malloc) heap grew
+(heap-malloc) free gave the pages back
+(heap-malloc) end
+heap-malloc: exit(0)
+EOF
+pass;
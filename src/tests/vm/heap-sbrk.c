@@ -0,0 +1,49 @@
+/* Grows and shrinks the heap with sbrk(), checking that new heap
+   memory reads as zeros, that memory given back and then added
+   again reads as zeros too, and that the break cannot move below
+   the heap's start or into the stack.  Finally touches memory
+   above the break, which must kill the process. */
+
+#include <stdint.h>
+#include <string.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define PAGE_SIZE 4096
+
+/* Returns true if the CNT bytes at P are all zero. */
+static bool
+is_zero (const uint8_t *p, size_t cnt)
+{
+  size_t i;
+
+  for (i = 0; i < cnt; i++)
+    if (p[i] != 0)
+      return false;
+  return true;
+}
+
+void
+test_main (void)
+{
+  uint8_t *start = sbrk (0);
+
+  CHECK (sbrk (3 * PAGE_SIZE) == start, "grow heap by 3 pages");
+  CHECK (sbrk (0) == start + 3 * PAGE_SIZE, "break moved up");
+  CHECK (is_zero (start, 3 * PAGE_SIZE), "new heap is zeroed");
+  memset (start, 0x5a, 3 * PAGE_SIZE);
+
+  CHECK (sbrk (-2 * PAGE_SIZE) == start + 3 * PAGE_SIZE,
+         "shrink heap by 2 pages");
+  CHECK (sbrk (PAGE_SIZE) == start + PAGE_SIZE, "grow heap by 1 page");
+  CHECK (start[0] == 0x5a, "kept page is intact");
+  CHECK (is_zero (start + PAGE_SIZE, PAGE_SIZE), "regrown page is zeroed");
+
+  CHECK (sbrk (-3 * PAGE_SIZE) == (void *) -1, "shrink below start fails");
+  CHECK (sbrk (INTPTR_MAX) == (void *) -1, "grow into stack fails");
+  CHECK (sbrk (0) == start + 2 * PAGE_SIZE, "break unchanged");
+
+  msg ("touch above break");
+  fail ("read %d above break", start[2 * PAGE_SIZE]);
+}
@@ -0,0 +1,20 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(heap-sbrk) begin
+(heap-sbrk) grow heap by 3 pages
+(heap-sbrk) break moved up
+(heap-sbrk) new heap is zeroed
+(heap-sbrk) shrink heap by 2 pages
+(heap-sbrk) grow heap by 1 page
+(heap-sbrk) kept page is intact
+(heap-sbrk) regrown page is zeroed
+(heap-sbrk) shrink below start fails
+(heap-sbrk) grow into stack fails
+(heap-sbrk) break unchanged
+(heap-sbrk) touch above break
+heap-sbrk: exit(-1)
+EOF
+pass;
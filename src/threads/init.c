@@ -4,6 +4,7 @@
 #include <inttypes.h>
 #include <limits.h>
 #include <random.h>
+#include <round.h>
 #include <stddef.h>
 #include <stdio.h>
 #include <stdlib.h>
@@ -34,9 +35,15 @@
 #ifdef FILESYS
 #include "devices/block.h"
 #include "devices/ide.h"
+#include "devices/stripe.h"
 #include "filesys/filesys.h"
 #include "filesys/fsutil.h"
 #endif
+#ifdef VM
+#include "vm/frame.h"
+#include "vm/page.h"
+#include "vm/swap.h"
+#endif
 
 /* Page directory with kernel mappings only. */
 uint32_t *init_page_dir;
@@ -52,6 +59,10 @@ static const char *scratch_bdev_name;
 #ifdef VM
 static const char *swap_bdev_name;
 #endif
+
+/* -stripe: Comma-separated names of block devices to stripe
+   together into "md0". */
+static char *stripe_bdev_names;
 #endif /* FILESYS */
 
 /* -ul: Maximum number of pages to put into palloc's user pool. */
@@ -67,6 +78,7 @@ static void usage (void);
 
 #ifdef FILESYS
 static void locate_block_devices (void);
+static void create_stripe (void);
 static void locate_block_device (enum block_type, const char *name);
 #endif
 
@@ -113,6 +125,7 @@ main (void)
 #ifdef USERPROG
   exception_init ();
   syscall_init ();
+  process_init ();
 #endif
 
   /* Start thread scheduler and enable interrupts. */
@@ -127,6 +140,12 @@ main (void)
   filesys_init (format_filesys);
 #endif
 
+#ifdef VM
+  /* Initialize virtual memory. */
+  frame_init ();
+  swap_init ();
+#endif
+
   printf ("Boot complete.\n");
   
   /* Run actions specified on kernel command line. */
@@ -150,20 +169,45 @@ bss_init (void)
   memset (&_start_bss, 0, &_end_bss - &_start_bss);
 }
 
+/* CR4 flags. */
+#define CR4_PSE 0x00000010      /* Enable 4 MB pages. */
+#define CR4_PGE 0x00000080      /* Enable global pages. */
+
+/* Returns true if the CPU has all of the FEATURES, a set of
+   CPUID_* flags. */
+bool
+cpu_has (uint32_t features)
+{
+  uint32_t eax = 1, ebx, ecx, edx;
+
+  asm ("cpuid" : "+a" (eax), "=b" (ebx), "=c" (ecx), "=d" (edx));
+  return (edx & features) == features;
+}
+
 /* Populates the base page directory and page table with the
    kernel virtual mapping, and then sets up the CPU to use the
    new page directory.  Points init_page_dir to the page
-   directory it creates. */
+   directory it creates.
+
+   If the CPU allows, each 4 MB region of RAM that does not hold
+   kernel text, which must be mapped read-only page by page, is
+   mapped with a single 4 MB page, which takes one TLB entry
+   instead of 1,024.  The kernel mapping is also made global, so
+   that its TLB entries survive the CR3 loads that switch between
+   processes' page directories. */
 static void
 paging_init (void)
 {
   uint32_t *pd, *pt;
   size_t page;
   extern char _start, _end_kernel_text;
+  bool pse = cpu_has (CPUID_PSE);
+  uint32_t global = cpu_has (CPUID_PGE) ? PTE_G : 0;
+  uint32_t cr4;
 
   pd = init_page_dir = palloc_get_page (PAL_ASSERT | PAL_ZERO);
   pt = NULL;
-  for (page = 0; page < init_ram_pages; page++)
+  for (page = 0; page < init_ram_pages; )
     {
       uintptr_t paddr = page * PGSIZE;
       char *vaddr = ptov (paddr);
@@ -171,15 +215,33 @@ paging_init (void)
       size_t pte_idx = pt_no (vaddr);
       bool in_kernel_text = &_start <= vaddr && vaddr < &_end_kernel_text;
 
+      if (pse && pte_idx == 0 && init_ram_pages - page >= PTSPAN / PGSIZE
+          && (vaddr + PTSPAN <= &_start || vaddr >= &_end_kernel_text))
+        {
+          pd[pde_idx] = paddr | PTE_PS | PTE_P | PTE_W | global;
+          page += PTSPAN / PGSIZE;
+          continue;
+        }
+
       if (pd[pde_idx] == 0)
         {
           pt = palloc_get_page (PAL_ASSERT | PAL_ZERO);
           pd[pde_idx] = pde_create (pt);
         }
 
-      pt[pte_idx] = pte_create_kernel (vaddr, !in_kernel_text);
+      pt[pte_idx] = pte_create_kernel (vaddr, !in_kernel_text) | global;
+      page++;
     }
 
+  /* Turn on the paging features used above.  4 MB pages must be
+     enabled before a page directory that has them is loaded. */
+  asm volatile ("movl %%cr4, %0" : "=r" (cr4));
+  if (pse)
+    cr4 |= CR4_PSE;
+  if (global)
+    cr4 |= CR4_PGE;
+  asm volatile ("movl %0, %%cr4" : : "r" (cr4));
+
   /* Store the physical address of the page directory into CR3
      aka PDBR (page directory base register).  This activates our
      new page tables immediately.  See [IA32-v2a] "MOV--Move
@@ -247,6 +309,14 @@ parse_options (char **argv)
         filesys_bdev_name = value;
       else if (!strcmp (name, "-scratch"))
         scratch_bdev_name = value;
+      else if (!strcmp (name, "-stripe"))
+        stripe_bdev_names = value;
+      else if (!strcmp (name, "-elevator"))
+        {
+          if (value == NULL || !block_set_elevator (value))
+            PANIC ("unknown elevator `%s' (use -h for help)",
+                   value != NULL ? value : "");
+        }
 #ifdef VM
       else if (!strcmp (name, "-swap"))
         swap_bdev_name = value;
@@ -259,6 +329,10 @@ parse_options (char **argv)
 #ifdef USERPROG
       else if (!strcmp (name, "-ul"))
         user_page_limit = atoi (value);
+#endif
+#ifdef VM
+      else if (!strcmp (name, "-stack"))
+        page_stack_max = ROUND_UP ((size_t) atoi (value) * 1024, PGSIZE);
 #endif
       else
         PANIC ("unknown option `%s' (use -h for help)", name);
@@ -373,6 +447,9 @@ usage (void)
           "  -f                 Format file system device during startup.\n"
           "  -filesys=BDEV      Use BDEV for file system instead of default.\n"
           "  -scratch=BDEV      Use BDEV for scratch instead of default.\n"
+          "  -stripe=BDEV,BDEV  Stripe BDEVs into md0 and use it for file system.\n"
+          "  -elevator=NAME     Order disk requests with NAME: deadline,\n"
+          "                     clook, or fifo.  Default: deadline.\n"
 #ifdef VM
           "  -swap=BDEV         Use BDEV for swap instead of default.\n"
 #endif
@@ -381,6 +458,9 @@ usage (void)
           "  -mlfqs             Use multi-level feedback queue scheduler.\n"
 #ifdef USERPROG
           "  -ul=COUNT          Limit user memory to COUNT pages.\n"
+#endif
+#ifdef VM
+          "  -stack=KB          Limit each user stack to KB kB.  Default: 8192.\n"
 #endif
           );
   shutdown_power_off ();
@@ -391,6 +471,8 @@ usage (void)
 static void
 locate_block_devices (void)
 {
+  if (stripe_bdev_names != NULL)
+    create_stripe ();
   locate_block_device (BLOCK_FILESYS, filesys_bdev_name);
   locate_block_device (BLOCK_SCRATCH, scratch_bdev_name);
 #ifdef VM
@@ -398,6 +480,32 @@ locate_block_devices (void)
 #endif
 }
 
+/* Creates block device "md0" striped across the devices named
+   in the -stripe option, and makes it the default file system
+   device. */
+static void
+create_stripe (void)
+{
+  struct block *members[STRIPE_MAX];
+  size_t cnt = 0;
+  char *name, *save_ptr;
+
+  for (name = strtok_r (stripe_bdev_names, ",", &save_ptr); name != NULL;
+       name = strtok_r (NULL, ",", &save_ptr))
+    {
+      if (cnt >= STRIPE_MAX)
+        PANIC ("too many devices to stripe (at most %d)", STRIPE_MAX);
+      members[cnt] = block_get_by_name (name);
+      if (members[cnt] == NULL)
+        PANIC ("%s: no such block device", name);
+      cnt++;
+    }
+
+  stripe_create ("md0", BLOCK_FILESYS, members, cnt);
+  if (filesys_bdev_name == NULL)
+    filesys_bdev_name = "md0";
+}
+
 /* Figures out what block device to use for the given ROLE: the
    block device with the given NAME, if NAME is non-null,
    otherwise the first block device in probe order of type
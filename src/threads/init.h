@@ -9,4 +9,11 @@
 /* Page directory with kernel mappings only. */
 extern uint32_t *init_page_dir;
 
+/* CPUID function 1 feature flags, in EDX. */
+#define CPUID_PSE 0x00000008    /* Page size extension: 4 MB pages. */
+#define CPUID_SEP 0x00000800    /* SYSENTER and SYSEXIT. */
+#define CPUID_PGE 0x00002000    /* Page global enable. */
+
+bool cpu_has (uint32_t features);
+
 #endif /* threads/init.h */
@@ -0,0 +1,63 @@
+#include "threads/objcache.h"
+#include <debug.h>
+#include <stdbool.h>
+#include <string.h>
+#include "threads/interrupt.h"
+
+/* Initializes OC as an empty cache of SIZE-byte objects that are
+   obtained from ALLOC, which returns a null pointer on failure,
+   and freed with RELEASE. */
+void
+objcache_init (struct objcache *oc, void *(*alloc) (void),
+               void (*release) (void *), size_t size)
+{
+  oc->alloc = alloc;
+  oc->release = release;
+  oc->size = size;
+  oc->cnt = 0;
+}
+
+/* Returns a zeroed object from OC, or a null pointer if there is
+   no free object and a new one cannot be allocated.  Reused
+   objects are zeroed here rather than when they are freed, to
+   keep the work out of objcache_put(), which may run with
+   interrupts off. */
+void *
+objcache_get (struct objcache *oc)
+{
+  enum intr_level old_level;
+  void *obj = NULL;
+
+  old_level = intr_disable ();
+  if (oc->cnt > 0)
+    obj = oc->free[--oc->cnt];
+  intr_set_level (old_level);
+
+  if (obj == NULL)
+    obj = oc->alloc ();
+  if (obj != NULL)
+    memset (obj, 0, oc->size);
+  return obj;
+}
+
+/* Frees OBJ, which was obtained from OC, keeping it for reuse if
+   OC has room for it. */
+void
+objcache_put (struct objcache *oc, void *obj)
+{
+  enum intr_level old_level;
+  bool kept = false;
+
+  ASSERT (obj != NULL);
+
+  old_level = intr_disable ();
+  if (oc->cnt < OBJCACHE_SIZE)
+    {
+      oc->free[oc->cnt++] = obj;
+      kept = true;
+    }
+  intr_set_level (old_level);
+
+  if (!kept)
+    oc->release (obj);
+}
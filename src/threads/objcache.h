@@ -0,0 +1,34 @@
+#ifndef THREADS_OBJCACHE_H
+#define THREADS_OBJCACHE_H
+
+#include <stddef.h>
+
+/* Number of free objects an object cache keeps. */
+#define OBJCACHE_SIZE 8
+
+/* A cache of free objects of one type.
+
+   Objects that are freed go on a small stack instead of back to
+   the allocator that they came from, as long as there is room,
+   and are handed out again before any new ones are allocated.
+   This suits objects that are created and destroyed in quick
+   succession, such as those for each process.
+
+   The stack is protected by disabling interrupts, so objects may
+   be freed from contexts that cannot sleep, such as the
+   scheduler. */
+struct objcache
+  {
+    void *(*alloc) (void);      /* Allocates a new object. */
+    void (*release) (void *);   /* Frees an object for good. */
+    size_t size;                /* Size of an object, in bytes. */
+    size_t cnt;                 /* Number of objects in FREE. */
+    void *free[OBJCACHE_SIZE];  /* Free objects. */
+  };
+
+void objcache_init (struct objcache *, void *(*alloc) (void),
+                    void (*release) (void *), size_t size);
+void *objcache_get (struct objcache *);
+void objcache_put (struct objcache *, void *);
+
+#endif /* threads/objcache.h */
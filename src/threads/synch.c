@@ -31,6 +31,10 @@
 #include <string.h>
 #include "threads/interrupt.h"
 #include "threads/thread.h"
+#ifdef LOCK_PROFILE
+#include <inttypes.h>
+#include "devices/timer.h"
+#endif
 
 /* Initializes semaphore SEMA to VALUE.  A semaphore is a
    nonnegative integer along with two atomic operators for
@@ -174,11 +178,55 @@ sema_test_helper (void *sema_)
    instead of a lock. */
 void
 lock_init (struct lock *lock)
+{
+  lock_init_named (lock, NULL);
+}
+
+#ifdef LOCK_PROFILE
+/* Contention statistics shared by all locks with the same name.
+   Profiles live in a static table, never in the lock itself, so
+   that locks embedded in freed objects (inodes, cache entries,
+   ...) do not leave dangling pointers behind. */
+struct lock_profile
+  {
+    const char *name;                   /* Name passed to lock_init. */
+    unsigned long long acquire_cnt;     /* Successful acquisitions. */
+    unsigned long long contended_cnt;   /* Acquisitions that had to wait. */
+    int64_t wait_ticks;                 /* Total ticks spent waiting. */
+    int64_t max_wait_ticks;             /* Longest single wait. */
+    int64_t hold_ticks;                 /* Total ticks the lock was held. */
+  };
+
+/* Maximum number of distinct lock names that can be profiled. */
+#define LOCK_PROFILE_CNT 64
+
+/* Number of locks reported by lock_print_stats(). */
+#define LOCK_PROFILE_TOP 8
+
+static struct lock_profile lock_profiles[LOCK_PROFILE_CNT];
+static size_t lock_profile_cnt;
+
+static struct lock_profile *lock_profile_lookup (const char *name);
+static void lock_profile_acquired (struct lock_profile *, bool contended,
+                                   int64_t waited);
+#endif
+
+/* Initializes LOCK, as lock_init(), and gives it NAME.  With
+   LOCK_PROFILE defined, locks that share a NAME accumulate
+   contention statistics together and are reported by
+   lock_print_stats().  NAME must outlive the lock; a null NAME
+   leaves the lock unprofiled. */
+void
+lock_init_named (struct lock *lock, const char *name UNUSED)
 {
   ASSERT (lock != NULL);
 
   lock->holder = NULL;
   sema_init (&lock->semaphore, 1);
+#ifdef LOCK_PROFILE
+  lock->profile = name != NULL ? lock_profile_lookup (name) : NULL;
+  lock->acquire_tick = 0;
+#endif
 }
 
 /* Acquires LOCK, sleeping until it becomes available if
@@ -196,6 +244,22 @@ lock_acquire (struct lock *lock)
   ASSERT (!intr_context ());
   ASSERT (!lock_held_by_current_thread (lock));
 
+#ifdef LOCK_PROFILE
+  if (lock->profile != NULL)
+    {
+      int64_t start = timer_ticks ();
+      bool contended = !sema_try_down (&lock->semaphore);
+
+      if (contended)
+        sema_down (&lock->semaphore);
+      lock->acquire_tick = timer_ticks ();
+      lock_profile_acquired (lock->profile, contended,
+                             lock->acquire_tick - start);
+      lock->holder = thread_current ();
+      return;
+    }
+#endif
+
   sema_down (&lock->semaphore);
   lock->holder = thread_current ();
 }
@@ -216,7 +280,16 @@ lock_try_acquire (struct lock *lock)
 
   success = sema_try_down (&lock->semaphore);
   if (success)
-    lock->holder = thread_current ();
+    {
+      lock->holder = thread_current ();
+#ifdef LOCK_PROFILE
+      if (lock->profile != NULL)
+        {
+          lock->acquire_tick = timer_ticks ();
+          lock_profile_acquired (lock->profile, false, 0);
+        }
+#endif
+    }
   return success;
 }
 
@@ -231,6 +304,15 @@ lock_release (struct lock *lock)
   ASSERT (lock != NULL);
   ASSERT (lock_held_by_current_thread (lock));
 
+#ifdef LOCK_PROFILE
+  if (lock->profile != NULL)
+    {
+      int64_t held = timer_ticks () - lock->acquire_tick;
+      enum intr_level old_level = intr_disable ();
+      lock->profile->hold_ticks += held;
+      intr_set_level (old_level);
+    }
+#endif
   lock->holder = NULL;
   sema_up (&lock->semaphore);
 }
@@ -336,3 +418,90 @@ cond_broadcast (struct condition *cond, struct lock *lock)
   while (!list_empty (&cond->waiters))
     cond_signal (cond, lock);
 }
+
+#ifdef LOCK_PROFILE
+/* Returns the profile for locks named NAME, creating it if
+   necessary.  Returns a null pointer if the profile table is
+   full, in which case the lock goes unprofiled. */
+static struct lock_profile *
+lock_profile_lookup (const char *name)
+{
+  struct lock_profile *p = NULL;
+  enum intr_level old_level;
+  size_t i;
+
+  old_level = intr_disable ();
+  for (i = 0; i < lock_profile_cnt; i++)
+    if (!strcmp (lock_profiles[i].name, name))
+      {
+        p = &lock_profiles[i];
+        break;
+      }
+  if (p == NULL && lock_profile_cnt < LOCK_PROFILE_CNT)
+    {
+      p = &lock_profiles[lock_profile_cnt++];
+      p->name = name;
+    }
+  intr_set_level (old_level);
+
+  return p;
+}
+
+/* Counts an acquisition of a lock profiled in P, which had to
+   wait WAITED ticks if CONTENDED.  P is shared by every lock with
+   the same name, and its 64-bit counters cannot be updated
+   atomically, so this is done with interrupts off. */
+static void
+lock_profile_acquired (struct lock_profile *p, bool contended,
+                       int64_t waited)
+{
+  enum intr_level old_level = intr_disable ();
+
+  p->acquire_cnt++;
+  if (contended)
+    {
+      p->contended_cnt++;
+      p->wait_ticks += waited;
+      if (waited > p->max_wait_ticks)
+        p->max_wait_ticks = waited;
+    }
+  intr_set_level (old_level);
+}
+
+/* Prints the LOCK_PROFILE_TOP most contended locks, most
+   contended first. */
+void
+lock_print_stats (void)
+{
+  bool reported[LOCK_PROFILE_CNT];
+  int rank;
+
+  memset (reported, 0, sizeof reported);
+  printf ("Locks: top %d contended of %zu profiled\n",
+          LOCK_PROFILE_TOP, lock_profile_cnt);
+  for (rank = 0; rank < LOCK_PROFILE_TOP; rank++)
+    {
+      struct lock_profile *best = NULL;
+      size_t i, best_idx = 0;
+
+      for (i = 0; i < lock_profile_cnt; i++)
+        if (!reported[i]
+            && (best == NULL
+                || lock_profiles[i].contended_cnt > best->contended_cnt
+                || (lock_profiles[i].contended_cnt == best->contended_cnt
+                    && lock_profiles[i].wait_ticks > best->wait_ticks)))
+          {
+            best = &lock_profiles[i];
+            best_idx = i;
+          }
+      if (best == NULL || best->acquire_cnt == 0)
+        break;
+      reported[best_idx] = true;
+
+      printf ("  %s: %llu acquires, %llu contended, "
+              "%"PRId64" wait ticks (max %"PRId64"), %"PRId64" hold ticks\n",
+              best->name, best->acquire_cnt, best->contended_cnt,
+              best->wait_ticks, best->max_wait_ticks, best->hold_ticks);
+    }
+}
+#endif
@@ -3,6 +3,7 @@
 
 #include <list.h>
 #include <stdbool.h>
+#include <stdint.h>
 
 /* A counting semaphore. */
 struct semaphore 
@@ -22,9 +23,14 @@ struct lock
   {
     struct thread *holder;      /* Thread holding lock (for debugging). */
     struct semaphore semaphore; /* Binary semaphore controlling access. */
+#ifdef LOCK_PROFILE
+    struct lock_profile *profile; /* Contention statistics, if named. */
+    int64_t acquire_tick;       /* Timer tick at which holder acquired it. */
+#endif
   };
 
 void lock_init (struct lock *);
+void lock_init_named (struct lock *, const char *name);
 void lock_acquire (struct lock *);
 bool lock_try_acquire (struct lock *);
 void lock_release (struct lock *);
@@ -41,6 +47,12 @@ void cond_wait (struct condition *, struct lock *);
 void cond_signal (struct condition *, struct lock *);
 void cond_broadcast (struct condition *, struct lock *);
 
+#ifdef LOCK_PROFILE
+/* Lock contention profiling.
+   Enabled by adding -DLOCK_PROFILE to DEFINES. */
+void lock_print_stats (void);
+#endif
+
 /* Optimization barrier.
 
    The compiler will not reorder operations across an
@@ -8,6 +8,7 @@
 #include "threads/flags.h"
 #include "threads/interrupt.h"
 #include "threads/intr-stubs.h"
+#include "threads/objcache.h"
 #include "threads/palloc.h"
 #include "threads/switch.h"
 #include "threads/synch.h"
@@ -43,6 +44,8 @@ static struct lock tid_lock;
 */
 static struct list sleep_list;
 
+/* Pages of threads that have exited, kept for new threads. */
+static struct objcache thread_pages;
 
 /* Stack frame for kernel_thread(). */
 struct kernel_thread_frame 
@@ -74,6 +77,7 @@ static struct thread *next_thread_to_run (void);
 static void init_thread (struct thread *, const char *name, int priority);
 static bool is_thread (struct thread *) UNUSED;
 static void *alloc_frame (struct thread *, size_t size);
+static void *alloc_thread_page (void);
 static void schedule (void);
 void thread_schedule_tail (struct thread *prev);
 static tid_t allocate_tid (void);
@@ -96,11 +100,11 @@ thread_init (void)
 {
   ASSERT (intr_get_level () == INTR_OFF);
 
-  lock_init (&tid_lock);
+  lock_init_named (&tid_lock, "tid_lock");
   list_init (&ready_list);
   list_init (&all_list);
   list_init (&sleep_list);
-
+  objcache_init (&thread_pages, alloc_thread_page, palloc_free_page, PGSIZE);
 
   /* Set up a thread structure for the running thread. */
   initial_thread = running_thread ();
@@ -198,7 +202,7 @@ thread_create (const char *name, int priority,
   ASSERT (function != NULL);
 
   /* Allocate thread. */
-  t = palloc_get_page (PAL_ZERO);
+  t = objcache_get (&thread_pages);
   if (t == NULL)
     return TID_ERROR;
 
@@ -490,10 +494,16 @@ init_thread (struct thread *t, const char *name, int priority)
   t->magic = THREAD_MAGIC;
 
 #ifdef USERPROG
-  list_init (&t->file_list);
-  t->next_fd = 2;
+  t->fd_free = 2;
   t->exit_status = 0;
   list_init(&t->child_list);
+  list_init (&t->dead_children);
+  lock_init (&t->dead_lock);
+  cond_init (&t->child_exited);
+#ifdef VM
+  list_init (&t->mappings);
+  t->next_mapid = 0;
+#endif
 #endif
 
   t->cwd = NULL;
@@ -568,14 +578,22 @@ thread_schedule_tail (struct thread *prev)
      thread.  This must happen late so that thread_exit() doesn't
      pull out the rug under itself.  (We don't free
      initial_thread because its memory was not obtained via
-     palloc().) */
+     palloc().)  The page is kept for reuse by a new thread if
+     there is room in the cache. */
   if (prev != NULL && prev->status == THREAD_DYING && prev != initial_thread) 
     {
       ASSERT (prev != cur);
-      palloc_free_page (prev);
+      objcache_put (&thread_pages, prev);
     }
 }
 
+/* Allocates a page for a thread, for the thread page cache. */
+static void *
+alloc_thread_page (void)
+{
+  return palloc_get_page (0);
+}
+
 /* Schedules a new process.  At entry, interrupts must be off and
    the running process's state must have been changed from
    running to some other state.  This function finds another
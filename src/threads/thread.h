@@ -6,6 +6,9 @@
 #include <list.h>
 #include <stdint.h>
 
+struct file_node;
+struct intr_frame;
+
 /* States in a thread's life cycle. */
 enum thread_status
   {
@@ -98,12 +101,26 @@ struct thread
     /* Owned by userprog/process.c. */
     uint32_t *pagedir;                  /* Page directory. */
     int exit_status;                    /* Exit status of the thread. */
-    struct list file_list;              /* List of files opened by the thread. */
-    uint32_t next_fd;                   /* Next file descriptor to be assigned. */
+    struct file_node *fds;              /* Open files, indexed by fd. */
+    int fd_cnt;                         /* Number of slots in FDS. */
+    int fd_free;                        /* No free slot in FDS below this. */
 
     struct list child_list;             /* List of child processes. Node type is pa_ch_link */
+    struct list dead_children;          /* Exited children not yet waited for, in order of exit. Node type is pa_ch_link */
+    struct lock dead_lock;              /* Protects dead_children. */
+    struct condition child_exited;      /* Signaled when a child joins dead_children. */
     struct pa_ch_link *pa_link;
     struct file* exec_file;
+    unsigned minor_faults;              /* Faults served without I/O. */
+    unsigned major_faults;              /* Faults that read a file or swap. */
+#ifdef VM
+    struct hash *pages;                 /* Supplemental page table. */
+    struct list mappings;               /* Memory-mapped files. */
+    int next_mapid;                     /* Next mapping identifier. */
+    struct intr_frame *syscall_frame;   /* User state on syscall entry. */
+    uint8_t *heap_start;                /* Start of the heap. */
+    uint8_t *heap_brk;                  /* End of the heap, its "break". */
+#endif
 #endif
 
     /* For sleeping thread. 
@@ -133,40 +150,13 @@ struct pa_ch_link
   struct thread* parent; 
   struct thread* child;
   int child_tid;
-  struct semaphore child_dead;         /* Semaphore to check if child prcess is dead.  0: alive; 1:dead*/
+  struct list_elem dead_elem;   /* The list element of parent's dead_children. */
+  bool dead;                    /* Has the child exited?  Protected by parent's dead_lock. */
   struct semaphore child_start; /* Semaphore to check if child finishes starting.*/
   int exit_code; // child process exit code. Used by process_wait.
   bool success; // Whether child process loaded successfully.
 };
 
-/* When a process exited, unlink the relationship with its parent or children
-   You should call lock_aquire(&link->lock); before call this.
-   Then you should't call lock_release(&link->lock);
-*/
-static void process_unlink(struct pa_ch_link *link)
-{
-  link->reference_cnt--;
-  if (link->reference_cnt == 0)
-  {
-    free(link);
-  } else {
-    lock_release(&link->lock);
-  }
-}
-
-/* Element of file_list in thread */
-struct file_node
-{
-  int fd; /* File descriptor. */
-  bool is_dir;
-  union
-  {
-    struct file *file; /* File. */
-    struct dir *dir;
-  };
-  struct list_elem elem; /* List element. */
-};
-
 /* If false (default), use round-robin scheduler.
    If true, use multi-level feedback queue scheduler.
    Controlled by kernel command-line option "-o mlfqs". */
@@ -1,14 +1,26 @@
 #include "userprog/exception.h"
 #include <inttypes.h>
+#include <memstat.h>
 #include <stdio.h>
 #include "userprog/gdt.h"
+#include "userprog/syscall.h"
+#include "threads/flags.h"
 #include "threads/interrupt.h"
+#include "threads/palloc.h"
 #include "threads/thread.h"
+#include "threads/vaddr.h"
+#ifdef VM
+#include "vm/page.h"
+#endif
 
 /* Number of page faults processed. */
 static long long page_fault_cnt;
 
+/* Number of each kind of paging event. */
+static unsigned paging_cnts[PAGING_EVENT_CNT];
+
 static void kill (struct intr_frame *);
+static void debug (struct intr_frame *);
 static void page_fault (struct intr_frame *);
 
 /* Registers handlers for interrupts that can be caused by user
@@ -43,7 +55,7 @@ exception_init (void)
      caused indirectly, e.g. #DE can be caused by dividing by
      0.  */
   intr_register_int (0, 0, INTR_ON, kill, "#DE Divide Error");
-  intr_register_int (1, 0, INTR_ON, kill, "#DB Debug Exception");
+  intr_register_int (1, 0, INTR_ON, debug, "#DB Debug Exception");
   intr_register_int (6, 0, INTR_ON, kill, "#UD Invalid Opcode Exception");
   intr_register_int (7, 0, INTR_ON, kill,
                      "#NM Device Not Available Exception");
@@ -64,7 +76,49 @@ exception_init (void)
 void
 exception_print_stats (void) 
 {
+  struct memstat m;
+
+  exception_get_stats (&m);
   printf ("Exception: %lld page faults\n", page_fault_cnt);
+  printf ("Paging: %u minor faults, %u major faults, %u evictions, "
+          "%u swap ins, %u swap outs\n",
+          m.total_minor_faults, m.total_major_faults, m.evictions,
+          m.swap_ins, m.swap_outs);
+  printf ("Memory: %u free kernel pages, %u free user pages\n",
+          m.kernel_free, m.user_free);
+}
+
+/* Counts paging EVENT, and for faults, also charges it to the
+   current process. */
+void
+exception_count (enum paging_event event)
+{
+  struct thread *t = thread_current ();
+
+  ASSERT (event < PAGING_EVENT_CNT);
+  paging_cnts[event]++;
+  if (event == PAGING_MINOR_FAULT)
+    t->minor_faults++;
+  else if (event == PAGING_MAJOR_FAULT)
+    t->major_faults++;
+}
+
+/* Stores the current process's and the system's paging and
+   memory statistics into *M. */
+void
+exception_get_stats (struct memstat *m)
+{
+  struct thread *t = thread_current ();
+
+  m->minor_faults = t->minor_faults;
+  m->major_faults = t->major_faults;
+  m->total_minor_faults = paging_cnts[PAGING_MINOR_FAULT];
+  m->total_major_faults = paging_cnts[PAGING_MAJOR_FAULT];
+  m->evictions = paging_cnts[PAGING_EVICTION];
+  m->swap_ins = paging_cnts[PAGING_SWAP_IN];
+  m->swap_outs = paging_cnts[PAGING_SWAP_OUT];
+  m->kernel_free = palloc_free_cnt (0);
+  m->user_free = palloc_free_cnt (PAL_USER);
 }
 
 /* Handler for an exception (probably) caused by a user process. */
@@ -108,6 +162,22 @@ kill (struct intr_frame *f)
     }
 }
 
+/* Debug exception handler.  SYSENTER turns off interrupts but
+   not single-stepping, so a user program that sets the trap flag
+   just before SYSENTER gets a single-step trap in the kernel, at
+   sysenter_entry, before it has switched stacks.  Turn the flag
+   off and resume there; the user program does not get it back,
+   since sysenter_entry does not save its EFLAGS.  Any other
+   debug exception is handled like the rest. */
+static void
+debug (struct intr_frame *f)
+{
+  if (f->cs == SEL_KCSEG && f->eip == sysenter_entry)
+    f->eflags &= ~FLAG_TF;
+  else
+    kill (f);
+}
+
 /* Page fault handler.  This is a skeleton that must be filled in
    to implement virtual memory.  Some solutions to project 2 may
    also require modifying this code.
@@ -148,6 +218,27 @@ page_fault (struct intr_frame *f)
   write = (f->error_code & PF_W) != 0;
   user = (f->error_code & PF_U) != 0;
 
+#ifdef VM
+  if (is_user_vaddr (fault_addr))
+    {
+      struct intr_frame *uf = user ? f : thread_current ()->syscall_frame;
+
+      /* A page that the process may access but that is not in
+         memory yet, or that the stack is growing into, so bring
+         it in.  The faulting access may come from the kernel,
+         e.g. when a system call touches a user buffer, in which
+         case f->esp is the kernel's stack pointer and the user's
+         was saved on entry to the system call. */
+      if (not_present
+          && page_load (fault_addr, uf != NULL ? uf->esp : NULL, write))
+        return;
+
+      /* A write to a page shared copy-on-write since fork(). */
+      if (!not_present && write && page_copy_on_write (fault_addr))
+        return;
+    }
+#endif
+
   /* To implement virtual memory, delete the rest of the function
      body, and replace it with code that brings in the page to
      which fault_addr refers. */
@@ -6,7 +6,23 @@
 #define PF_W 0x2    /* 0: read, 1: write. */
 #define PF_U 0x4    /* 0: kernel, 1: user process. */
 
+struct memstat;
+
+/* Paging events, counted for exception_print_stats() and the
+   memstat system call. */
+enum paging_event
+  {
+    PAGING_MINOR_FAULT,         /* Fault served without I/O. */
+    PAGING_MAJOR_FAULT,         /* Fault that read a file or swap. */
+    PAGING_EVICTION,            /* Frame taken from its pages. */
+    PAGING_SWAP_IN,             /* Page read from swap. */
+    PAGING_SWAP_OUT,            /* Page written to swap. */
+    PAGING_EVENT_CNT
+  };
+
 void exception_init (void);
+void exception_count (enum paging_event);
+void exception_get_stats (struct memstat *);
 void exception_print_stats (void);
 
 #endif /* userprog/exception.h */
@@ -0,0 +1,162 @@
+#include "userprog/fdtable.h"
+#include <debug.h>
+#include <string.h>
+#include "filesys/directory.h"
+#include "filesys/file.h"
+#include "threads/malloc.h"
+#include "threads/thread.h"
+
+/* Each process's file descriptor table is an array of
+   file_nodes indexed by file descriptor, so that finding the
+   file for a descriptor takes constant time.  The array is grown
+   by doubling as files are opened, and the nodes live in it, so
+   opening a file does not allocate anything else.
+
+   As in POSIX, a new file is given the lowest free descriptor.
+   Descriptors 0 and 1 are the console, so the first two slots
+   are never used. */
+
+/* Number of slots in a new table. */
+#define FDTABLE_MIN 16
+
+/* Advances T's FD_FREE to the lowest free slot in its table,
+   growing the table if it is full.  Returns true if successful,
+   false if memory is exhausted. */
+static bool
+reserve (struct thread *t)
+{
+  struct file_node *fds;
+  int cnt;
+
+  for (; t->fd_free < t->fd_cnt; t->fd_free++)
+    if (t->fds[t->fd_free].file == NULL)
+      return true;
+
+  cnt = t->fd_cnt > 0 ? t->fd_cnt * 2 : FDTABLE_MIN;
+  fds = realloc (t->fds, cnt * sizeof *fds);
+  if (fds == NULL)
+    return false;
+  memset (fds + t->fd_cnt, 0, (cnt - t->fd_cnt) * sizeof *fds);
+  t->fds = fds;
+  t->fd_cnt = cnt;
+  return true;
+}
+
+/* Adds FILE or DIR, exactly one of which must be non-null, to
+   the current process's table, and returns its file descriptor.
+   Returns -1 if memory is exhausted. */
+int
+fdtable_open (struct file *file, struct dir *dir)
+{
+  struct thread *t = thread_current ();
+  struct file_node *n;
+
+  ASSERT ((file == NULL) != (dir == NULL));
+
+  if (!reserve (t))
+    return -1;
+  n = &t->fds[t->fd_free];
+  n->is_dir = dir != NULL;
+  if (n->is_dir)
+    n->dir = dir;
+  else
+    n->file = file;
+  return t->fd_free++;
+}
+
+/* Returns the current process's open file with descriptor FD, or
+   a null pointer if there is none. */
+struct file_node *
+fdtable_get (int fd)
+{
+  struct thread *t = thread_current ();
+
+  if (fd < 2 || fd >= t->fd_cnt || t->fds[fd].file == NULL)
+    return NULL;
+  return &t->fds[fd];
+}
+
+/* Closes the file in slot N and frees the slot. */
+static void
+close_node (struct file_node *n)
+{
+  if (n->is_dir)
+    dir_close (n->dir);
+  else
+    file_close (n->file);
+  n->file = NULL;
+}
+
+/* Closes the current process's open file with descriptor FD.
+   Returns false if there is none. */
+bool
+fdtable_close (int fd)
+{
+  struct thread *t = thread_current ();
+  struct file_node *n = fdtable_get (fd);
+
+  if (n == NULL)
+    return false;
+  close_node (n);
+  if (fd < t->fd_free)
+    t->fd_free = fd;
+  return true;
+}
+
+/* Gives the current process, which must have an empty table, a
+   copy of PARENT's, in which each file is reopened at the same
+   position under the same descriptor.  Returns true if
+   successful, false if memory is exhausted, in which case the
+   files reopened so far stay open in the current process's
+   table. */
+bool
+fdtable_copy (struct thread *parent)
+{
+  struct thread *t = thread_current ();
+  int fd;
+
+  ASSERT (t->fds == NULL);
+
+  t->fds = calloc (parent->fd_cnt, sizeof *t->fds);
+  if (parent->fd_cnt > 0 && t->fds == NULL)
+    return false;
+  t->fd_cnt = parent->fd_cnt;
+  t->fd_free = parent->fd_free;
+
+  for (fd = 2; fd < parent->fd_cnt; fd++)
+    {
+      struct file_node *p = &parent->fds[fd];
+      struct file_node *c = &t->fds[fd];
+
+      if (p->file == NULL)
+        continue;
+      c->is_dir = p->is_dir;
+      if (p->is_dir)
+        c->dir = dir_reopen (p->dir);
+      else
+        {
+          c->file = file_reopen (p->file);
+          if (c->file != NULL)
+            file_seek (c->file, file_tell (p->file));
+        }
+      if (c->file == NULL)
+        return false;
+    }
+  return true;
+}
+
+/* Closes all of the current process's open files and frees its
+   table. */
+void
+fdtable_destroy (void)
+{
+  struct thread *t = thread_current ();
+  int fd;
+
+  for (fd = 2; fd < t->fd_cnt; fd++)
+    if (t->fds[fd].file != NULL)
+      close_node (&t->fds[fd]);
+  free (t->fds);
+  t->fds = NULL;
+  t->fd_cnt = 0;
+}
@@ -0,0 +1,27 @@
+#ifndef USERPROG_FDTABLE_H
+#define USERPROG_FDTABLE_H
+
+#include <stdbool.h>
+
+struct thread;
+
+/* An open file or directory, in a slot of its process's file
+   descriptor table.  A slot is free if FILE, and so DIR, is
+   null. */
+struct file_node
+  {
+    bool is_dir;                /* Is this a directory? */
+    union
+      {
+        struct file *file;      /* File, if !IS_DIR. */
+        struct dir *dir;        /* Directory, if IS_DIR. */
+      };
+  };
+
+int fdtable_open (struct file *, struct dir *);
+struct file_node *fdtable_get (int fd);
+bool fdtable_close (int fd);
+bool fdtable_copy (struct thread *parent);
+void fdtable_destroy (void);
+
+#endif /* userprog/fdtable.h */
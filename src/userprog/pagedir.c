@@ -156,6 +156,16 @@ pagedir_clear_page (uint32_t *pd, void *upage)
     }
 }
 
+/* Returns true if the PTE for virtual page VPAGE in PD is
+   present and allows user writes.
+   Returns false if PD contains no PTE for VPAGE. */
+bool
+pagedir_is_writable (uint32_t *pd, const void *vpage)
+{
+  uint32_t *pte = lookup_page (pd, vpage, false);
+  return pte != NULL && (*pte & (PTE_P | PTE_W)) == (PTE_P | PTE_W);
+}
+
 /* Returns true if the PTE for virtual page VPAGE in PD is dirty,
    that is, if the page has been modified since the PTE was
    installed.
@@ -214,6 +224,21 @@ pagedir_set_accessed (uint32_t *pd, const void *vpage, bool accessed)
     }
 }
 
+/* Sets the writable bit to WRITABLE in the PTE for user virtual
+   page UPAGE in PD, which must be mapped. */
+void
+pagedir_set_writable (uint32_t *pd, const void *upage, bool writable)
+{
+  uint32_t *pte = lookup_page (pd, upage, false);
+
+  ASSERT (pte != NULL && (*pte & PTE_P) != 0);
+  if (writable)
+    *pte |= PTE_W;
+  else
+    *pte &= ~(uint32_t) PTE_W;
+  invalidate_pagedir (pd);
+}
+
 /* Loads page directory PD into the CPU's page directory base
    register. */
 void
@@ -3,28 +3,100 @@
 #include "filesys/directory.h"
 #include "filesys/file.h"
 #include "filesys/filesys.h"
+#include "filesys/inode.h"
 #include "list.h"
 #include "threads/flags.h"
 #include "threads/init.h"
 #include "threads/interrupt.h"
+#include "threads/objcache.h"
 #include "threads/palloc.h"
 #include "threads/synch.h"
 #include "threads/thread.h"
 #include "threads/vaddr.h"
+#include "userprog/fdtable.h"
 #include "userprog/gdt.h"
 #include "userprog/pagedir.h"
 #include "userprog/tss.h"
+#ifdef VM
+#include "vm/mmap.h"
+#include "vm/page.h"
+#endif
 #include <debug.h>
 #include <inttypes.h>
 #include <round.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <wait.h>
 #include "threads/malloc.h"
 
+/* Passed from process_execute() to start_process(), in a page
+   of its own. */
+struct exec_info
+  {
+    struct pa_ch_link *link;            /* Link between parent and child. */
+    char *file_name;                    /* Program name, later in the page. */
+    int argc;                           /* Number of words in CMDLINE. */
+    char cmdline[];                     /* Command line. */
+  };
+
+/* Links of processes that have exited, kept for new ones. */
+static struct objcache links;
+
+/* Allocates a link, for the link cache. */
+static void *
+alloc_link (void)
+{
+  return malloc (sizeof (struct pa_ch_link));
+}
+
+/* When a process exited, unlink the relationship with its parent or children
+   You should call lock_aquire(&link->lock); before call this.
+   Then you should't call lock_release(&link->lock);
+*/
+static void process_unlink(struct pa_ch_link *link)
+{
+  link->reference_cnt--;
+  if (link->reference_cnt == 0)
+  {
+    objcache_put(&links, link);
+  } else {
+    lock_release(&link->lock);
+  }
+}
+
 static thread_func start_process NO_RETURN;
-static bool load (const char *cmdline, void (**eip) (void), void **esp);
-static bool setup_arguments(void **esp, const char* argument_string);
+static bool load (const struct exec_info *, void (**eip) (void), void **esp);
+static bool setup_arguments (void **esp, const char *cmdline, int argc);
+
+/* Returns the number of space-separated words in CMDLINE, and
+   stores the start and length of the first one, the program
+   name, in *NAME and *NAME_LEN. */
+static int
+parse_cmdline (const char *cmdline, const char **name, size_t *name_len)
+{
+  int argc = 0;
+
+  *name = cmdline;
+  *name_len = 0;
+  while (*cmdline != '\0')
+    {
+      const char *word;
+
+      while (*cmdline == ' ')
+        cmdline++;
+      if (*cmdline == '\0')
+        break;
+      for (word = cmdline; *cmdline != ' ' && *cmdline != '\0'; cmdline++)
+        continue;
+      if (argc++ == 0)
+        {
+          *name = word;
+          *name_len = cmdline - word;
+        }
+    }
+  return argc;
+}
 
 /* Starts a new thread running a user program loaded from
    FILENAME.  The new thread may be scheduled (and may even exit)
@@ -33,48 +105,51 @@ static bool setup_arguments(void **esp, const char* argument_string);
 tid_t
 process_execute (const char *file_name)
 {
-  //printf("process_execute: %s\n",file_name);
-  char *fn_copy;
+  struct exec_info *info;
+  const char *name;
+  size_t cmdline_len = strlen (file_name);
+  size_t name_len;
+  int argc;
   tid_t tid;
 
-  /* Make a copy of FILE_NAME.
-     Otherwise there's a race between the caller and load(). */
-  fn_copy = palloc_get_page (0);
-  if (fn_copy == NULL)
+  /* Make a copy of FILE_NAME, followed by a copy of just the
+     program name.  Otherwise there's a race between the caller
+     and load(). */
+  argc = parse_cmdline (file_name, &name, &name_len);
+  if (sizeof *info + cmdline_len + name_len + 2 > PGSIZE)
     return TID_ERROR;
-  strlcpy (fn_copy, file_name, PGSIZE);
-  void *file_name_real = malloc(strlen(file_name)+1);
-  strlcpy(file_name_real,file_name,strlen(file_name)+1);
-  /*void *fn_tmp=malloc(strlen(file_name)+1);
-  strlcpy (fn_tmp, file_name, strlen(file_name)+1);
-  char* token,*save_ptr;
-  token=strtok_r(fn_tmp, " ", &save_ptr);*/
-
-  //cut the real filename
-  char* save_ptr;
-  strtok_r(file_name_real, " ", &save_ptr);
+  info = palloc_get_page (0);
+  if (info == NULL)
+    return TID_ERROR;
+  memcpy (info->cmdline, file_name, cmdline_len + 1);
+  info->file_name = info->cmdline + cmdline_len + 1;
+  memcpy (info->file_name, name, name_len);
+  info->file_name[name_len] = '\0';
+  info->argc = argc;
 
   //passing parent thread to child.
   struct thread* cur=thread_current();
-  struct pa_ch_link* link=malloc(sizeof(struct pa_ch_link));
+  struct pa_ch_link* link=objcache_get(&links);
+  if (link == NULL) {
+    palloc_free_page (info);
+    return TID_ERROR;
+  }
   link->parent=cur;
   link->reference_cnt=2;
   link->child_tid=0;
-  sema_init(&link->child_dead, 0);
+  link->dead=false;
   sema_init(&link->child_start,0);
   lock_init(&link->lock);
-
-  int len=strlen(fn_copy);
-  *(void**)(fn_copy+len+1)=link;
+  info->link = link;
 
   lock_acquire(&link->lock); //child shouldn't dead before parent init link.
 
   /* Create a new thread to execute FILE_NAME. */
-  tid = thread_create (file_name_real, PRI_DEFAULT, start_process, fn_copy);
+  tid = thread_create (info->file_name, PRI_DEFAULT, start_process, info);
   if (tid == TID_ERROR) {
     lock_release(&link->lock);
-    palloc_free_page (fn_copy);
-    free(link);
+    palloc_free_page (info);
+    objcache_put(&links, link);
   } else {
     sema_down(&link->child_start);
     if (!link->success) {
@@ -86,26 +161,21 @@ process_execute (const char *file_name)
       list_push_back(&cur->child_list, &link->child_list_elem);
     }
   } 
-  
-  
-  free(file_name_real);
+
   return tid;
 }
 
 /* A thread function that loads a user process and starts it
    running. */
 static void
-start_process (void *file_name_)
+start_process (void *info_)
 {
-  char *file_name = file_name_;
-  //printf("start_process: %s\n",file_name);
+  struct exec_info *info = info_;
   struct intr_frame if_;
   bool success;
 
-
   struct thread* cur=thread_current();
-  int len=strlen(file_name);
-  cur->pa_link = *(void**)(file_name+len+1);
+  cur->pa_link = info->link;
   cur->pa_link->child = cur;
   cur->pa_link->child_tid = cur->tid;
 
@@ -114,10 +184,10 @@ start_process (void *file_name_)
   if_.gs = if_.fs = if_.es = if_.ds = if_.ss = SEL_UDSEG;
   if_.cs = SEL_UCSEG;
   if_.eflags = FLAG_IF | FLAG_MBS;
-  success = load (file_name, &if_.eip, &if_.esp);
+  success = load (info, &if_.eip, &if_.esp);
   if (cur->tid!=1) cur->pa_link->success=success;
 
-  palloc_free_page (file_name);
+  palloc_free_page (info);
   /* If load failed, quit. */
   if (!success) {
     cur->exit_status=-1;
@@ -136,31 +206,208 @@ start_process (void *file_name_)
   NOT_REACHED ();
 }
 
+#ifdef VM
+/* Passed from process_fork() to start_fork(). */
+struct fork_info
+  {
+    struct thread *parent;              /* Forking process. */
+    struct intr_frame *if_;             /* Parent's registers. */
+    struct pa_ch_link *link;            /* Link between the two. */
+  };
+
+static thread_func start_fork NO_RETURN;
+static bool fork_files (struct thread *parent);
+
+/* Starts a new process that is a copy of the current one, which
+   entered the kernel with registers IF_.  The child's memory
+   shares frames with the parent's until either writes to them,
+   and it inherits the parent's open files.  In the child, the
+   system call returns 0.  Returns the child's thread id, or
+   TID_ERROR if the child cannot be created. */
+tid_t
+process_fork (struct intr_frame *if_)
+{
+  struct thread *cur = thread_current ();
+  struct fork_info info;
+  struct pa_ch_link *link = objcache_get (&links);
+  tid_t tid;
+
+  if (link == NULL)
+    return TID_ERROR;
+  link->parent = cur;
+  link->reference_cnt = 2;
+  link->child_tid = 0;
+  link->dead = false;
+  sema_init (&link->child_start, 0);
+  lock_init (&link->lock);
+
+  info.parent = cur;
+  info.if_ = if_;
+  info.link = link;
+
+  lock_acquire (&link->lock);
+  tid = thread_create (cur->name, cur->priority, start_fork, &info);
+  if (tid == TID_ERROR)
+    {
+      lock_release (&link->lock);
+      objcache_put (&links, link);
+      return TID_ERROR;
+    }
+
+  /* INFO is on our stack, so wait for the child to be done
+     with it. */
+  sema_down (&link->child_start);
+  if (!link->success)
+    {
+      process_unlink (link);
+      return TID_ERROR;
+    }
+  lock_release (&link->lock);
+  link->child_tid = tid;
+  list_push_back (&cur->child_list, &link->child_list_elem);
+  return tid;
+}
+
+/* A thread function that copies the forking process described
+   by INFO_ into the new thread and starts it running. */
+static void
+start_fork (void *info_)
+{
+  struct fork_info *info = info_;
+  struct thread *parent = info->parent;
+  struct thread *cur = thread_current ();
+  struct intr_frame if_ = *info->if_;
+  bool success = false;
+
+  cur->pa_link = info->link;
+  cur->pa_link->child = cur;
+  cur->pa_link->child_tid = cur->tid;
+
+  cur->pagedir = pagedir_create ();
+  if (cur->pagedir == NULL)
+    goto done;
+  process_activate ();
+  cur->pages = page_table_create ();
+  if (cur->pages == NULL)
+    goto done;
+  cur->exec_file = file_reopen (parent->exec_file);
+  if (cur->exec_file == NULL)
+    goto done;
+  file_deny_write (cur->exec_file);
+  success = (page_table_copy (parent->pages, cur->exec_file)
+             && fork_files (parent));
+  cur->heap_start = parent->heap_start;
+  cur->heap_brk = parent->heap_brk;
+
+ done:
+  /* The parent may return, taking INFO with it, as soon as we
+     signal child_start. */
+  cur->pa_link->success = success;
+  if (!success)
+    {
+      cur->exit_status = -1;
+      sema_up (&cur->pa_link->child_start);
+      thread_exit ();
+    }
+  sema_up (&cur->pa_link->child_start);
+
+  /* Return 0 from fork() in the child. */
+  if_.eax = 0;
+  asm volatile("movl %0, %%esp; jmp intr_exit" : : "g"(&if_) : "memory");
+  NOT_REACHED ();
+}
+
+/* Gives the current process its own handles on PARENT's working
+   directory and open files, with the same file descriptors and
+   positions.  Returns true if successful, false if memory is
+   exhausted. */
+static bool
+fork_files (struct thread *parent)
+{
+  struct thread *cur = thread_current ();
+
+  if (parent->cwd != NULL)
+    {
+      cur->cwd = dir_reopen (parent->cwd);
+      if (cur->cwd == NULL)
+        return false;
+    }
+
+  return fdtable_copy (parent);
+}
+#endif
+
 /* Waits for thread TID to die and returns its exit status.  If
    it was terminated by the kernel (i.e. killed due to an
    exception), returns -1.  If TID is invalid or if it was not a
    child of the calling process, or if process_wait() has already
    been successfully called for the given TID, returns -1
-   immediately, without waiting.
-
-   This function will be implemented in problem 2-2.  For now, it
-   does nothing. */
+   immediately, without waiting. */
 int
-process_wait (tid_t child_tid UNUSED)
+process_wait (tid_t child_tid)
 {
-  struct thread *cur=thread_current();
-  for(struct list_elem *e = list_begin(&cur->child_list); e!=list_end(&cur->child_list); e=list_next(e)) {
-    struct pa_ch_link *link = list_entry(e, struct pa_ch_link, child_list_elem);
-    if (link->child_tid==child_tid) {
-      list_remove(e);
-      sema_down(&link->child_dead);
-      lock_acquire(&link->lock);
-      int exit_code = link->exit_code;
-      process_unlink(link);
-      return exit_code;
+  int status;
+
+  if (child_tid == WAIT_ANY
+      || process_waitpid (child_tid, &status, 0) != child_tid)
+    return -1;
+  return status;
+}
+
+/* Waits for child process CHILD_TID to die, or for any child if
+   CHILD_TID is WAIT_ANY, stores its exit status in *STATUS, and
+   returns its tid.  Children that have exited are kept in order
+   of exit on the current process's dead_children queue, so
+   waiting for any child reaps whichever exited first.  If
+   OPTIONS includes WNOHANG, returns 0 instead of waiting if no
+   such child has exited yet.  Returns -1 if CHILD_TID is not a
+   child of the calling process that has not been waited for, or
+   if it is WAIT_ANY and there are no such children. */
+tid_t
+process_waitpid (tid_t child_tid, int *status, int options)
+{
+  struct thread *cur = thread_current ();
+  struct pa_ch_link *link = NULL;
+
+  if (child_tid != WAIT_ANY)
+    {
+      struct list_elem *e;
+
+      for (e = list_begin (&cur->child_list); e != list_end (&cur->child_list);
+           e = list_next (e))
+        {
+          link = list_entry (e, struct pa_ch_link, child_list_elem);
+          if (link->child_tid == child_tid)
+            break;
+        }
+      if (e == list_end (&cur->child_list))
+        return -1;
     }
-  }
-  return -1;
+  else if (list_empty (&cur->child_list))
+    return -1;
+
+  lock_acquire (&cur->dead_lock);
+  while (link != NULL ? !link->dead : list_empty (&cur->dead_children))
+    {
+      if (options & WNOHANG)
+        {
+          lock_release (&cur->dead_lock);
+          return 0;
+        }
+      cond_wait (&cur->child_exited, &cur->dead_lock);
+    }
+  if (link == NULL)
+    link = list_entry (list_front (&cur->dead_children),
+                       struct pa_ch_link, dead_elem);
+  list_remove (&link->dead_elem);
+  lock_release (&cur->dead_lock);
+
+  list_remove (&link->child_list_elem);
+  child_tid = link->child_tid;
+  lock_acquire (&link->lock);
+  *status = link->exit_code;
+  process_unlink (link);
+  return child_tid;
 }
 
 /* Free the current process's resources. */
@@ -170,34 +417,57 @@ process_exit (void)
   struct thread *cur = thread_current ();
   bool success = (cur->tid==1) || cur->pa_link->success;
   if (cur->tid!=1) {
-    lock_acquire(&cur->pa_link->lock);
-    cur->pa_link->exit_code=cur->exit_status;
-    sema_up(&cur->pa_link->child_dead);
-    process_unlink(cur->pa_link);
-    file_close(cur->exec_file);
-  }
-
-  for(struct list_elem *e = list_begin(&cur->child_list); e!=list_end(&cur->child_list); e=list_next(e)) {
-    struct pa_ch_link* link=list_entry(e, struct pa_ch_link, child_list_elem);
+    struct pa_ch_link *link = cur->pa_link;
     lock_acquire(&link->lock);
-    link->parent=NULL;
+    link->exit_code=cur->exit_status;
+    /* Tell the parent, if it is still there to wait for us. */
+    if (link->parent != NULL && link->success) {
+      struct thread *parent = link->parent;
+      lock_acquire (&parent->dead_lock);
+      link->dead = true;
+      list_push_back (&parent->dead_children, &link->dead_elem);
+      cond_signal (&parent->child_exited, &parent->dead_lock);
+      lock_release (&parent->dead_lock);
+    }
     process_unlink(link);
+    file_close(cur->exec_file);
   }
 
+  /* Orphan the children first, so that none of them queues its
+     link on dead_children once that has been emptied, then drop
+     our references to their links, which may free them. */
+  struct list_elem *e, *next;
+  for (e = list_begin (&cur->child_list); e != list_end (&cur->child_list);
+       e = list_next (e))
+    {
+      struct pa_ch_link *link
+          = list_entry (e, struct pa_ch_link, child_list_elem);
+      lock_acquire (&link->lock);
+      link->parent = NULL;
+      lock_release (&link->lock);
+    }
+  lock_acquire (&cur->dead_lock);
+  list_init (&cur->dead_children);
+  lock_release (&cur->dead_lock);
+  for (e = list_begin (&cur->child_list); e != list_end (&cur->child_list);
+       e = next)
+    {
+      struct pa_ch_link *link
+          = list_entry (e, struct pa_ch_link, child_list_elem);
+      next = list_next (e);
+      lock_acquire (&link->lock);
+      process_unlink (link);
+    }
+
+#ifdef VM
+  /* Writes back mapped files before they are closed below. */
+  mmap_unmap_all ();
+#endif
+
   /* Close all unclosed file and free the memory */
   if (cur->cwd)
     dir_close(cur->cwd);
-  for (struct list_elem *e = list_begin (&cur->file_list);
-       e != list_end (&cur->file_list);)
-    {
-      struct file_node *f = list_entry (e, struct file_node, elem);
-      e = list_next (e);
-      if (f->is_dir)
-        dir_close(f->dir);
-      else
-        file_close (f->file);
-      free (f);
-    }
+  fdtable_destroy ();
 
   uint32_t *pd;
 
@@ -209,6 +479,12 @@ process_exit (void)
       if (success) {
         printf ("%s: exit(%d)\n", cur->name, cur->exit_status);
       }
+#ifdef VM
+      /* Frees the process's frames, so it must come before the
+         page directory goes away. */
+      page_table_destroy (cur->pages);
+      cur->pages = NULL;
+#endif
       /* Correct ordering here is crucial.  We must set
          cur->pagedir to NULL before switching page directories,
          so that a timer interrupt can't switch back to the
@@ -301,135 +577,370 @@ struct Elf32_Phdr
 #define PF_W 2 /* Writable. */
 #define PF_R 4 /* Readable. */
 
-static bool setup_stack (void **esp, const char*);
+static bool setup_stack (void **esp, const char *cmdline, int argc);
 static bool validate_segment (const struct Elf32_Phdr *, struct file *);
 static bool load_segment (struct file *file, off_t ofs, uint8_t *upage,
                           uint32_t read_bytes, uint32_t zero_bytes,
                           bool writable);
 
-/* Loads an ELF executable from FILE_NAME into the current thread.
-   Stores the executable's entry point into *EIP
-   and its initial stack pointer into *ESP.
-   Returns true if successful, false otherwise. */
-bool
-load (const char *file_name, void (**eip) (void), void **esp)
+/* Executable image cache.
+
+   Loading an executable means reading and validating its ELF
+   headers.  Workloads such as the shell's load the same few
+   executables over and over, so we keep the result for the most
+   recently loaded executables, keyed by inode.  An image holds a
+   reference to its inode, so that the inode cannot be freed and
+   another take its place at the same address, and it is used
+   only as long as the inode has not been written since. */
+
+/* A loadable segment of an executable, in the form that
+   load_segment() takes. */
+struct exec_segment
+  {
+    off_t file_page;            /* File offset of first page. */
+    uint8_t *mem_page;          /* User virtual address of first page. */
+    uint32_t read_bytes;        /* Bytes to read from the file. */
+    uint32_t zero_bytes;        /* Bytes to zero following them. */
+    bool writable;              /* May the process write the segment? */
+  };
+
+/* The parsed and validated headers of an executable. */
+struct exec_image
+  {
+    struct list_elem elem;      /* Element in exec_images. */
+    struct inode *inode;        /* The executable. */
+    unsigned write_cnt;         /* inode_write_cnt() when parsed. */
+    int ref_cnt;                /* Users, plus one while cached. */
+    void (*entry) (void);       /* Entry point. */
+    size_t seg_cnt;             /* Number of elements in SEGS. */
+    struct exec_segment segs[]; /* Loadable segments. */
+  };
+
+/* Maximum number of cached images. */
+#define EXEC_CACHE_SIZE 8
+
+static struct list exec_images; /* Cached images, most recently used first. */
+static size_t exec_image_cnt;   /* Number of cached images. */
+static struct lock exec_lock;   /* Protects the above and ref counts. */
+
+/* Initializes the executable image cache and the link cache. */
+void
+process_init (void)
 {
-  struct thread *t = thread_current ();
-  struct Elf32_Ehdr ehdr;
-  struct file *file = NULL;
-  off_t file_ofs;
-  bool success = false;
-  int i;
+  list_init (&exec_images);
+  lock_init (&exec_lock);
+  objcache_init (&links, alloc_link, free, sizeof (struct pa_ch_link));
+}
 
-  /* Allocate and activate page directory. */
-  t->pagedir = pagedir_create ();
-  if (t->pagedir == NULL)
-    goto done;
-  process_activate ();
+/* Frees IMAGE, which has no references left. */
+static void
+free_image (struct exec_image *image)
+{
+  ASSERT (image->ref_cnt == 0);
+  inode_close (image->inode);
+  free (image);
+}
 
-  //cut the real filename
-  int p=0;
-  for(; file_name[p]!=0 && file_name[p]!=' '; p++);
-  if (file_name[p]==0) {
-    p=-1;
-  } else {
-    ((char*)file_name)[p]='\0';
-  }
+/* Drops a reference to IMAGE, freeing it if it was the last. */
+static void
+put_image (struct exec_image *image)
+{
+  bool last;
 
-  /* Open executable file. */
-  file = filesys_open (file_name);
+  lock_acquire (&exec_lock);
+  last = --image->ref_cnt == 0;
+  lock_release (&exec_lock);
 
-  if (file == NULL)
+  if (last)
+    free_image (image);
+}
+
+/* Removes IMAGE from the cache, dropping the cache's reference
+   to it.  Returns IMAGE if that was its last reference, in which
+   case the caller, which must hold exec_lock, must free it with
+   free_image() after releasing the lock. */
+static struct exec_image *
+uncache_image (struct exec_image *image)
+{
+  list_remove (&image->elem);
+  exec_image_cnt--;
+  return --image->ref_cnt == 0 ? image : NULL;
+}
+
+/* Drops the cached images of executables that have been
+   removed, so that their inodes, which the cache keeps open, can
+   be freed once no process is loading them. */
+void
+process_purge_images (void)
+{
+  struct list stale;
+  struct list_elem *e, *next;
+
+  list_init (&stale);
+  lock_acquire (&exec_lock);
+  for (e = list_begin (&exec_images); e != list_end (&exec_images); e = next)
     {
-      //printf ("load: %s: open failed\n", file_name);
-      goto done;
+      struct exec_image *image = list_entry (e, struct exec_image, elem);
+
+      next = list_next (e);
+      if (inode_is_removed (image->inode)
+          && uncache_image (image) != NULL)
+        list_push_back (&stale, &image->elem);
     }
+  lock_release (&exec_lock);
 
-  file_deny_write(file);
-  t->exec_file=file;
-  
-  //restore the filename
-  if (p!=-1) {
-    ((char*)file_name)[p]=' ';
-  }
+  while (!list_empty (&stale))
+    {
+      free_image (list_entry (list_pop_front (&stale),
+                              struct exec_image, elem));
+    }
+}
+
+/* Reads and validates the ELF headers of FILE, named FILE_NAME,
+   and returns them as a new image with one reference, or a null
+   pointer if FILE is not a valid executable or memory is
+   exhausted. */
+static struct exec_image *
+parse_image (struct file *file, const char *file_name)
+{
+  struct Elf32_Ehdr ehdr;
+  struct Elf32_Phdr *phdrs;
+  struct exec_image *image = NULL;
+  size_t phdrs_size, seg_cnt;
+  int i;
 
   /* Read and verify executable header. */
-  if (file_read (file, &ehdr, sizeof ehdr) != sizeof ehdr
+  if (file_read_at (file, &ehdr, sizeof ehdr, 0) != sizeof ehdr
       || memcmp (ehdr.e_ident, "\177ELF\1\1\1", 7) || ehdr.e_type != 2
       || ehdr.e_machine != 3 || ehdr.e_version != 1
       || ehdr.e_phentsize != sizeof (struct Elf32_Phdr) || ehdr.e_phnum > 1024)
     {
       printf ("load: %s: error loading executable\n", file_name);
-      goto done;
+      return NULL;
     }
 
-  /* Read program headers. */
-  file_ofs = ehdr.e_phoff;
-  for (i = 0; i < ehdr.e_phnum; i++)
-    {
-      struct Elf32_Phdr phdr;
+  /* Read all the program headers at once. */
+  phdrs_size = ehdr.e_phnum * sizeof *phdrs;
+  if (ehdr.e_phoff > (Elf32_Off)file_length (file))
+    return NULL;
+  phdrs = malloc (phdrs_size);
+  if (phdrs == NULL && phdrs_size > 0)
+    return NULL;
+  if (file_read_at (file, phdrs, phdrs_size, ehdr.e_phoff)
+      != (off_t)phdrs_size)
+    goto done;
 
-      if (file_ofs < 0 || file_ofs > file_length (file))
+  /* Check them, counting the loadable segments. */
+  seg_cnt = 0;
+  for (i = 0; i < ehdr.e_phnum; i++)
+    switch (phdrs[i].p_type)
+      {
+      case PT_NULL:
+      case PT_NOTE:
+      case PT_PHDR:
+      case PT_STACK:
+      default:
+        /* Ignore this segment. */
+        break;
+      case PT_DYNAMIC:
+      case PT_INTERP:
+      case PT_SHLIB:
         goto done;
-      file_seek (file, file_ofs);
+      case PT_LOAD:
+        if (!validate_segment (&phdrs[i], file))
+          goto done;
+        seg_cnt++;
+        break;
+      }
 
-      if (file_read (file, &phdr, sizeof phdr) != sizeof phdr)
-        goto done;
-      file_ofs += sizeof phdr;
-      switch (phdr.p_type)
+  image = malloc (sizeof *image + seg_cnt * sizeof *image->segs);
+  if (image == NULL)
+    goto done;
+  image->inode = inode_reopen (file_get_inode (file));
+  image->write_cnt = inode_write_cnt (image->inode);
+  image->ref_cnt = 1;
+  image->entry = (void (*) (void))ehdr.e_entry;
+  image->seg_cnt = 0;
+
+  for (i = 0; i < ehdr.e_phnum; i++)
+    if (phdrs[i].p_type == PT_LOAD)
+      {
+        const struct Elf32_Phdr *phdr = &phdrs[i];
+        struct exec_segment *seg = &image->segs[image->seg_cnt++];
+        uint32_t page_offset = phdr->p_vaddr & PGMASK;
+
+        seg->writable = (phdr->p_flags & PF_W) != 0;
+        seg->file_page = phdr->p_offset & ~PGMASK;
+        seg->mem_page = (uint8_t *)(phdr->p_vaddr & ~PGMASK);
+        if (phdr->p_filesz > 0)
+          {
+            /* Normal segment.
+               Read initial part from disk and zero the rest. */
+            seg->read_bytes = page_offset + phdr->p_filesz;
+            seg->zero_bytes = (ROUND_UP (page_offset + phdr->p_memsz, PGSIZE)
+                               - seg->read_bytes);
+          }
+        else
+          {
+            /* Entirely zero.
+               Don't read anything from disk. */
+            seg->read_bytes = 0;
+            seg->zero_bytes = ROUND_UP (page_offset + phdr->p_memsz, PGSIZE);
+          }
+      }
+
+ done:
+  free (phdrs);
+  return image;
+}
+
+/* Returns the cached image of INODE with a new reference, moving
+   it to the front of the cache, or a null pointer if there is
+   none.  An image parsed before INODE was last written is removed
+   from the cache, and returned in *STALE if it must be freed, as
+   by uncache_image().  The caller must hold
+   exec_lock. */
+static struct exec_image *
+find_image (struct inode *inode, struct exec_image **stale)
+{
+  struct list_elem *e;
+
+  ASSERT (lock_held_by_current_thread (&exec_lock));
+
+  *stale = NULL;
+  for (e = list_begin (&exec_images); e != list_end (&exec_images);
+       e = list_next (e))
+    {
+      struct exec_image *image = list_entry (e, struct exec_image, elem);
+      if (image->inode == inode)
         {
-        case PT_NULL:
-        case PT_NOTE:
-        case PT_PHDR:
-        case PT_STACK:
-        default:
-          /* Ignore this segment. */
-          break;
-        case PT_DYNAMIC:
-        case PT_INTERP:
-        case PT_SHLIB:
-          goto done;
-        case PT_LOAD:
-          if (validate_segment (&phdr, file))
+          if (image->write_cnt == inode_write_cnt (inode))
             {
-              bool writable = (phdr.p_flags & PF_W) != 0;
-              uint32_t file_page = phdr.p_offset & ~PGMASK;
-              uint32_t mem_page = phdr.p_vaddr & ~PGMASK;
-              uint32_t page_offset = phdr.p_vaddr & PGMASK;
-              uint32_t read_bytes, zero_bytes;
-              if (phdr.p_filesz > 0)
-                {
-                  /* Normal segment.
-                     Read initial part from disk and zero the rest. */
-                  read_bytes = page_offset + phdr.p_filesz;
-                  zero_bytes = (ROUND_UP (page_offset + phdr.p_memsz, PGSIZE)
-                                - read_bytes);
-                }
-              else
-                {
-                  /* Entirely zero.
-                     Don't read anything from disk. */
-                  read_bytes = 0;
-                  zero_bytes = ROUND_UP (page_offset + phdr.p_memsz, PGSIZE);
-                }
-              if (!load_segment (file, file_page, (void *)mem_page, read_bytes,
-                                 zero_bytes, writable))
-                goto done;
+              list_remove (&image->elem);
+              list_push_front (&exec_images, &image->elem);
+              image->ref_cnt++;
+              return image;
             }
-          else
-            goto done;
+          *stale = uncache_image (image);
           break;
         }
     }
+  return NULL;
+}
 
-  /* Set up stack. */
-  if (!setup_stack (esp,file_name))
+/* Returns the image of executable FILE, named FILE_NAME, from the
+   cache if possible, otherwise by parsing its headers and adding
+   the result to the cache.  The caller must release the image
+   with put_image().  Returns a null pointer if FILE is not a
+   valid executable or memory is exhausted. */
+static struct exec_image *
+get_image (struct file *file, const char *file_name)
+{
+  struct inode *inode = file_get_inode (file);
+  struct exec_image *image, *cached, *stale, *evicted = NULL;
+
+  process_purge_images ();
+
+  lock_acquire (&exec_lock);
+  cached = find_image (inode, &stale);
+  lock_release (&exec_lock);
+  if (stale != NULL)
+    free_image (stale);
+  if (cached != NULL)
+    return cached;
+
+  image = parse_image (file, file_name);
+  if (image == NULL)
+    return NULL;
+
+  /* Another process may have cached the same executable while we
+     were parsing it.  If so, use its image instead of ours. */
+  lock_acquire (&exec_lock);
+  cached = find_image (inode, &stale);
+  if (cached == NULL)
+    {
+      image->ref_cnt++;
+      list_push_front (&exec_images, &image->elem);
+      if (++exec_image_cnt > EXEC_CACHE_SIZE)
+        evicted = uncache_image (list_entry (list_back (&exec_images),
+                                             struct exec_image, elem));
+    }
+  lock_release (&exec_lock);
+  if (stale != NULL)
+    free_image (stale);
+  if (evicted != NULL)
+    free_image (evicted);
+  if (cached != NULL)
+    {
+      put_image (image);
+      image = cached;
+    }
+
+  return image;
+}
+
+/* Loads the ELF executable named in INFO into the current
+   thread, with the arguments in INFO's command line.
+   Stores the executable's entry point into *EIP
+   and its initial stack pointer into *ESP.
+   Returns true if successful, false otherwise. */
+bool
+load (const struct exec_info *info, void (**eip) (void), void **esp)
+{
+  struct thread *t = thread_current ();
+  struct exec_image *image;
+  struct file *file = NULL;
+  bool success = false;
+  size_t i;
+
+  /* Allocate and activate page directory. */
+  t->pagedir = pagedir_create ();
+  if (t->pagedir == NULL)
+    goto done;
+  process_activate ();
+#ifdef VM
+  t->pages = page_table_create ();
+  if (t->pages == NULL)
     goto done;
+#endif
+
+  /* Open executable file. */
+  file = filesys_open (info->file_name);
+
+  if (file == NULL)
+    {
+      //printf ("load: %s: open failed\n", info->file_name);
+      goto done;
+    }
+
+  file_deny_write(file);
+  t->exec_file=file;
 
-  /* Start address. */
-  *eip = (void (*) (void))ehdr.e_entry;
+  /* Map the executable's segments. */
+  image = get_image (file, info->file_name);
+  if (image == NULL)
+    goto done;
+  for (i = 0; i < image->seg_cnt; i++)
+    {
+      const struct exec_segment *seg = &image->segs[i];
+
+      if (!load_segment (file, seg->file_page, seg->mem_page,
+                         seg->read_bytes, seg->zero_bytes, seg->writable))
+        break;
+#ifdef VM
+      /* The heap starts out empty, above the highest segment. */
+      if (seg->mem_page + seg->read_bytes + seg->zero_bytes > t->heap_start)
+        t->heap_start = t->heap_brk
+          = seg->mem_page + seg->read_bytes + seg->zero_bytes;
+#endif
+    }
+  *eip = image->entry;
+  success = i == image->seg_cnt;
+  put_image (image);
 
-  success = true;
+  /* Set up stack. */
+  if (success)
+    success = setup_stack (esp, info->cmdline, info->argc);
 
 done:
   /* We arrive here whether the load is successful or not. */
@@ -439,7 +950,9 @@ done:
 
 /* load() helpers. */
 
+#ifndef VM
 static bool install_page (void *upage, void *kpage, bool writable);
+#endif
 
 /* Checks whether PHDR describes a valid, loadable segment in
    FILE and returns true if so, false otherwise. */
@@ -498,6 +1011,10 @@ validate_segment (const struct Elf32_Phdr *phdr, struct file *file)
    The pages initialized by this function must be writable by the
    user process if WRITABLE is true, read-only otherwise.
 
+   With virtual memory, the pages are only recorded in the
+   supplemental page table here, and each is read in when the
+   process first touches it.
+
    Return true if successful, false if a memory allocation error
    or disk read error occurs. */
 static bool
@@ -508,7 +1025,9 @@ load_segment (struct file *file, off_t ofs, uint8_t *upage,
   ASSERT (pg_ofs (upage) == 0);
   ASSERT (ofs % PGSIZE == 0);
 
+#ifndef VM
   file_seek (file, ofs);
+#endif
   while (read_bytes > 0 || zero_bytes > 0)
     {
       /* Calculate how to fill this page.
@@ -517,6 +1036,15 @@ load_segment (struct file *file, off_t ofs, uint8_t *upage,
       size_t page_read_bytes = read_bytes < PGSIZE ? read_bytes : PGSIZE;
       size_t page_zero_bytes = PGSIZE - page_read_bytes;
 
+#ifdef VM
+      struct page *p = (page_read_bytes > 0
+                        ? page_add_file (upage, file, ofs, page_read_bytes,
+                                         writable)
+                        : page_add_zero (upage, writable));
+      if (p == NULL)
+        return false;
+      ofs += page_read_bytes;
+#else
       /* Get a page of memory. */
       uint8_t *kpage = palloc_get_page (PAL_USER);
       if (kpage == NULL)
@@ -536,6 +1064,7 @@ load_segment (struct file *file, off_t ofs, uint8_t *upage,
           palloc_free_page (kpage);
           return false;
         }
+#endif
 
       /* Advance. */
       read_bytes -= page_read_bytes;
@@ -546,10 +1075,18 @@ load_segment (struct file *file, off_t ofs, uint8_t *upage,
 }
 
 /* Create a minimal stack by mapping a zeroed page at the top of
-   user virtual memory. */
+   user virtual memory, and push the ARGC words of CMDLINE onto it
+   as arguments to main(). */
 static bool
-setup_stack (void **esp,const char* argument_string)
+setup_stack (void **esp, const char *cmdline, int argc)
 {
+#ifdef VM
+  uint8_t *upage = ((uint8_t *)PHYS_BASE) - PGSIZE;
+
+  return (page_add_zero (upage, true) != NULL
+          && page_load (upage, upage, true)
+          && setup_arguments (esp, cmdline, argc));
+#else
   uint8_t *kpage;
   bool success = false;
 
@@ -558,43 +1095,40 @@ setup_stack (void **esp,const char* argument_string)
     {
       success = install_page (((uint8_t *)PHYS_BASE) - PGSIZE, kpage, true);
       if (success)
-        success = setup_arguments(esp, argument_string);
+        success = setup_arguments (esp, cmdline, argc);
       else
         palloc_free_page (kpage);
     }
   return success;
+#endif
 }
 
+/* Copies CMDLINE to the top of the user stack and pushes the
+   arguments to main() below it: its ARGC words, which the copy is
+   split into, as argv[], then argv and argc, and a fake return
+   address.  Since ARGC is known in advance, argv[] is filled in
+   as the copy is split, in a single pass.  Stores the resulting
+   stack pointer in *ESP.  Returns false if CMDLINE is too long. */
 static bool
-setup_arguments (void **esp, const char *argument_string)
+setup_arguments (void **esp, const char *cmdline, int argc)
 {
-  uint8_t *top = PHYS_BASE;
-
-  unsigned int argument_length = strlen (argument_string) + 1;
-  if (argument_length > 1024)
+  size_t length = strlen (cmdline) + 1;
+  if (length > 1024)
     return false;
-  memcpy (top -= argument_length, argument_string, argument_length);
-  char *stack_argument_string = (char *)top;
 
-  unsigned int argc = 0;
+  char *args = (char *)PHYS_BASE - length;
+  strlcpy (args, cmdline, length);
+
+  char **argv = (char **)ROUND_DOWN ((uintptr_t)args, sizeof *argv) - argc - 1;
+  int i = 0;
   char *save_ptr;
-  for (char *token = strtok_r (stack_argument_string, " ", &save_ptr);
-       token != NULL; token = strtok_r (NULL, " ", &save_ptr))
-    {
-      *(char **)(top -= 4) = token;
-      argc++;
-    }
-  *(char **)(top -= 4) = NULL; /* The length of argv[] is argc + 1 */
-  char **argv = (char **)top;
-  /* Reverse argv[] */
-  for (char **front = argv, **back = argv + argc; front < back;
-       ++front, --back)
-    {
-      char *t = *front;
-      *front = *back;
-      *back = t;
-    }
+  for (char *token = strtok_r (args, " ", &save_ptr); token != NULL;
+       token = strtok_r (NULL, " ", &save_ptr))
+    argv[i++] = token;
+  ASSERT (i == argc);
+  argv[argc] = NULL;
 
+  uint8_t *top = (uint8_t *)argv;
   *(char ***)(top -= 4) = argv;
   *(int *)(top -= 4) = argc;
   *(int *)(top -= 4) = 0; /* Return address, never used */
@@ -602,6 +1136,7 @@ setup_arguments (void **esp, const char *argument_string)
   return true;
 }
 
+#ifndef VM
 /* Adds a mapping from user virtual address UPAGE to kernel
    virtual address KPAGE to the page table.
    If WRITABLE is true, the user process may modify the page;
@@ -621,3 +1156,4 @@ install_page (void *upage, void *kpage, bool writable)
   return (pagedir_get_page (t->pagedir, upage) == NULL
           && pagedir_set_page (t->pagedir, upage, kpage, writable));
 }
+#endif
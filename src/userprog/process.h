@@ -3,9 +3,15 @@
 
 #include "threads/thread.h"
 
+struct intr_frame;
+
 tid_t process_execute (const char *file_name);
+tid_t process_fork (struct intr_frame *);
 int process_wait (tid_t);
+tid_t process_waitpid (tid_t, int *status, int options);
 void process_exit (void);
 void process_activate (void);
+void process_init (void);
+void process_purge_images (void);
 
 #endif /* userprog/process.h */
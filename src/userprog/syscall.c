@@ -6,22 +6,58 @@
 #include "filesys/filesys.h"
 #include "filesys/inode.h"
 #include "stddef.h"
+#include "threads/init.h"
 #include "threads/interrupt.h"
+#include "threads/palloc.h"
 #include "threads/malloc.h"
 #include "threads/thread.h"
 #include "threads/vaddr.h"
+#include "userprog/exception.h"
+#include "userprog/fdtable.h"
+#include "userprog/gdt.h"
+#include "userprog/pagedir.h"
 #include "userprog/process.h"
+#include "userprog/tss.h"
+#ifdef VM
+#include "vm/mmap.h"
+#include "vm/page.h"
+#endif
+#include <iovec.h>
+#include <memstat.h>
+#include <ring.h>
 #include <stdint.h>
 #include <stdio.h>
+#include <string.h>
 #include <syscall-nr.h>
+#include <wait.h>
 
 typedef int pid_t;          /* Corresponding to the documents */
-int syscall_arg_number[30]; /* The number of arguments of every syscall */
-void *syscall_func[30];     /* The function pointer of every syscall */
-
-/* Get the file node by fd.
- * Returns the file_node address if successfull, NULL if not found. */
-static struct file_node *get_file_node_by_fd (struct list *file_list, int fd);
+int syscall_arg_number[SYS_CNT]; /* The number of arguments of every syscall */
+void *syscall_func[SYS_CNT];     /* The function pointer of every syscall */
+
+/* Model-specific registers that SYSENTER loads its kernel state
+   from.  SYSENTER and SYSEXIT derive the other selectors they
+   need from the code selector: with SEL_KCSEG, they get
+   SEL_KDSEG, SEL_UCSEG, and SEL_UDSEG. */
+#define MSR_SYSENTER_CS 0x174
+#define MSR_SYSENTER_ESP 0x175
+#define MSR_SYSENTER_EIP 0x176
+
+/* Stack that SYSENTER switches to.  The first instruction of
+   sysenter_entry leaves it for the running thread's kernel
+   stack, so it is used only by a single-step trap taken before
+   that instruction; see debug() in exception.c. */
+static uint32_t sysenter_stack[128];
+
+/* Address of the TSS's ring 0 stack pointer, for sysenter_entry. */
+void **sysenter_esp0;
+
+/* Writes VALUE to model-specific register MSR. */
+static inline void
+write_msr (uint32_t msr, uint32_t value)
+{
+  asm volatile ("wrmsr" : : "c"(msr), "a"(value), "d"(0));
+}
 
 /* Reads a byte at user virtual address UADDR.
    UADDR must be below PHYS_BASE.
@@ -48,48 +84,102 @@ put_user (uint8_t *udst, uint8_t byte)
   return error_code != -1;
 }
 
-/* Check if int is readable */
+/* Returns true if the SIZE bytes at UADDR lie entirely below
+   PHYS_BASE. */
 static bool
-check_int_get (int const *uaddr)
+is_user_range (const void *uaddr, size_t size)
 {
-  return is_user_vaddr ((uint8_t *)uaddr)
-         && is_user_vaddr ((uint8_t *)uaddr + 3)
-         && get_user ((uint8_t *)uaddr) != -1
-         && get_user ((uint8_t *)uaddr + 3) != -1;
+  const uint8_t *start = uaddr;
+  return start + size >= start && start + size <= (uint8_t *)PHYS_BASE;
 }
 
-/* Check if buffer is readable */
+/* Returns true if the process may read the SIZE bytes at user
+   address UADDR, and also write them if WRITE is true.  Checks
+   each page once: a page that is mapped with the right access
+   needs nothing more, and any other page is probed with a single
+   access, which brings it in if it is just not in memory yet. */
 static bool
-check_buffer_get (uint8_t const *buffer, unsigned size)
+check_user (const void *uaddr, size_t size, bool write)
 {
-  return is_user_vaddr (buffer) && is_user_vaddr (buffer + size - 1)
-         && get_user (buffer) != -1 && get_user (buffer + size - 1) != -1;
+  uint32_t *pd = thread_current ()->pagedir;
+  const uint8_t *end = (const uint8_t *)uaddr + size;
+  const uint8_t *p;
+
+  if (!is_user_range (uaddr, size))
+    return false;
+  for (p = uaddr; p < end; p = (const uint8_t *)pg_round_down (p) + PGSIZE)
+    {
+      const void *upage = pg_round_down (p);
+      int byte;
+
+      if (pagedir_get_page (pd, upage) != NULL
+          && (!write || pagedir_is_writable (pd, upage)))
+        continue;
+      byte = get_user (p);
+      if (byte == -1 || (write && !put_user ((uint8_t *)p, byte)))
+        return false;
+    }
+  return true;
 }
 
-/* Check if buffer is writable */
+/* Copies SIZE bytes from SRC to DST, either of which may be in
+   user memory, in one string move.  Returns true if successful,
+   false if it touched user memory that the process may not
+   access, in which case the page fault handler resumes at label
+   1 with eax set to -1. */
 static bool
-check_buffer_put (uint8_t *buffer, unsigned size)
+copy_user (void *dst, const void *src, size_t size)
 {
-  return check_buffer_get (buffer, size)
-         && put_user (buffer, get_user (buffer))
-         && put_user (buffer + size - 1, get_user (buffer + size - 1));
+  int result;
+  asm volatile ("movl $1f, %0; rep movsb; 1:"
+                : "=&a"(result), "+D"(dst), "+S"(src), "+c"(size)
+                :
+                : "memory");
+  return result != -1;
 }
 
-/* Check if string is valid */
+/* Copies SIZE bytes from user address USRC to DST.  Returns true
+   if successful, false if the process may not read USRC. */
 static bool
-check_string (char const *str)
+copy_from_user (void *dst, const void *usrc, size_t size)
 {
-  while (1)
+  return is_user_range (usrc, size) && copy_user (dst, usrc, size);
+}
+
+/* Copies SIZE bytes from SRC to user address UDST.  Returns true
+   if successful, false if the process may not write UDST. */
+static bool
+copy_to_user (void *udst, const void *src, size_t size)
+{
+  return is_user_range (udst, size) && copy_user (udst, src, size);
+}
+
+/* Copies the null-terminated string at user address USRC into
+   DST, which has room for SIZE bytes, and returns its length.
+   Returns -1 if the process may not read the string or if it
+   does not fit.  Copies up to a page at a time, so it may read
+   past the end of the string, but never past the end of the
+   page that holds its null terminator. */
+static int
+strncpy_from_user (char *dst, const char *usrc, size_t size)
+{
+  size_t len = 0;
+
+  while (len < size)
     {
-      if (!is_user_vaddr (str))
-        return false;
-      int r = get_user ((uint8_t const *)str);
-      if (r == 0)
-        return true;
-      if (r == -1)
-        return false;
-      str++;
+      size_t chunk = PGSIZE - pg_ofs (usrc + len);
+      char *null;
+
+      if (chunk > size - len)
+        chunk = size - len;
+      if (!copy_from_user (dst + len, usrc + len, chunk))
+        return -1;
+      null = memchr (dst + len, '\0', chunk);
+      if (null != NULL)
+        return null - dst;
+      len += chunk;
     }
+  return -1;
 }
 
 static void
@@ -98,6 +188,49 @@ exit (int status)
   thread_current ()->exit_status = status;
   thread_exit ();
 }
+
+/* Returns a copy of the string at user address USTR, in a new
+   page that the caller must free with palloc_free_page().
+   Terminates the process if it may not read the string, if the
+   string does not fit in a page, or if memory is exhausted. */
+static char *
+copy_in_string (const char *ustr)
+{
+  char *kstr = palloc_get_page (0);
+  if (kstr == NULL)
+    exit (-1);
+  if (strncpy_from_user (kstr, ustr, PGSIZE) < 0)
+    {
+      palloc_free_page (kstr);
+      exit (-1);
+    }
+  return kstr;
+}
+
+/* Keeps the SIZE bytes of user memory at BUFFER in memory until
+   unpin_buffer() is called, so that the file system can access
+   them without faulting while it holds its locks.  WRITE says
+   whether the kernel will write to the buffer.  Terminates the
+   process if that is not possible. */
+static void
+pin_buffer (const void *buffer UNUSED, unsigned size UNUSED,
+            bool write UNUSED)
+{
+#ifdef VM
+  if (!page_pin_buffer (buffer, size, write))
+    exit (-1);
+#endif
+}
+
+/* Undoes pin_buffer(). */
+static void
+unpin_buffer (const void *buffer UNUSED, unsigned size UNUSED)
+{
+#ifdef VM
+  page_unpin_buffer (buffer, size);
+#endif
+}
+
 static void
 halt (void)
 {
@@ -106,63 +239,82 @@ halt (void)
 static pid_t
 exec (const char *cmd_line)
 {
-  if (!check_string (cmd_line))
-    exit (-1);
-  return process_execute (cmd_line);
+  char *kcmd_line = copy_in_string (cmd_line);
+  pid_t pid = process_execute (kcmd_line);
+  palloc_free_page (kcmd_line);
+  return pid;
 }
 static int
 wait (pid_t pid)
 {
   return process_wait (pid);
 }
+
+static pid_t
+waitpid (pid_t pid, int *status, int options)
+{
+  if (status != NULL && !check_user (status, sizeof *status, true))
+    exit (-1);
+  if (options & ~WNOHANG)
+    return -1;
+
+  int exit_status;
+  pid_t reaped = process_waitpid (pid, &exit_status, options);
+  if (reaped > 0 && status != NULL
+      && !copy_to_user (status, &exit_status, sizeof exit_status))
+    exit (-1);
+  return reaped;
+}
 static int
 create (const char *file, unsigned initial_size)
 {
-  if (!check_string (file))
-    exit (-1);
+  char *kfile = copy_in_string (file);
   // printf ("create syscall: %s\n", file);
-  return filesys_create (file, initial_size);
+  int success = filesys_create (kfile, initial_size);
+  palloc_free_page (kfile);
+  return success;
 }
 static int
 remove (const char *file)
 {
-  if (!check_string (file))
-    exit (-1);
-  return filesys_remove (file);
+  char *kfile = copy_in_string (file);
+  int success = filesys_remove (kfile);
+  palloc_free_page (kfile);
+  if (success)
+    process_purge_images ();
+  return success;
 }
 static int
 open (const char *file)
 {
-  if (!check_string (file))
-    exit (-1);
+  char *kfile = copy_in_string (file);
   // printf ("open syscall: %s\n", file);
   struct file *f;
   struct dir *d;
 
-  if (!filesys_open_file_or_directory (file, &f, &d))
+  bool success = filesys_open_file_or_directory (kfile, &f, &d);
+  palloc_free_page (kfile);
+  if (!success)
     return -1;
 
   // printf ("f: %p, d: %p\n", f, d);
   ASSERT (f != NULL || d != NULL);
   ASSERT (f == NULL || d == NULL);
 
-  struct thread *t = thread_current ();
-  struct file_node *file_node = malloc (sizeof (struct file_node));
-  file_node->file = f;
-  if (d)
-    file_node->is_dir = true, file_node->dir = d;
-  else
-    file_node->is_dir = false, file_node->file = f;
-  // printf("isdir: %d\n", (int)file_node->is_dir);
-  file_node->fd = t->next_fd++;
-  list_push_back (&t->file_list, &file_node->elem);
-  return file_node->fd;
+  int fd = fdtable_open (f, d);
+  if (fd < 0)
+    {
+      if (d)
+        dir_close (d);
+      else
+        file_close (f);
+    }
+  return fd;
 }
 static int
 filesize (int fd)
 {
-  struct file_node *file_node
-      = get_file_node_by_fd (&thread_current ()->file_list, fd);
+  struct file_node *file_node = fdtable_get (fd);
   if (file_node)
     return file_length (file_node->file);
   else
@@ -172,7 +324,7 @@ filesize (int fd)
 static int
 read (int fd, void *buffer, unsigned size)
 {
-  if (!check_buffer_put (buffer, size))
+  if (!check_user (buffer, size, true))
     exit (-1);
 
   if (fd == 0)
@@ -184,19 +336,21 @@ read (int fd, void *buffer, unsigned size)
     }
   else
     {
-      struct file_node *file_node
-          = get_file_node_by_fd (&thread_current ()->file_list, fd);
+      struct file_node *file_node = fdtable_get (fd);
       if (!file_node)
         return -1;
       if (file_node->is_dir)
         exit (-1);
-      return file_read (file_node->file, buffer, size);
+      pin_buffer (buffer, size, true);
+      int result = file_read (file_node->file, buffer, size);
+      unpin_buffer (buffer, size);
+      return result;
     }
 }
 static int
 write (int fd, const void *buffer, unsigned size)
 {
-  if (!check_buffer_get (buffer, size))
+  if (!check_user (buffer, size, false))
     exit (-1);
 
   if (fd == 1)
@@ -206,20 +360,21 @@ write (int fd, const void *buffer, unsigned size)
     }
   else
     {
-      struct file_node *file_node
-          = get_file_node_by_fd (&thread_current ()->file_list, fd);
+      struct file_node *file_node = fdtable_get (fd);
       if (!file_node)
         exit (-1);
       if (file_node->is_dir)
         return -1;
-      return file_write (file_node->file, buffer, size);
+      pin_buffer (buffer, size, false);
+      int result = file_write (file_node->file, buffer, size);
+      unpin_buffer (buffer, size);
+      return result;
     }
 }
 static void
 seek (int fd, unsigned position)
 {
-  struct file_node *file_node
-      = get_file_node_by_fd (&thread_current ()->file_list, fd);
+  struct file_node *file_node = fdtable_get (fd);
   if (file_node)
     file_seek (file_node->file, position);
   else
@@ -228,8 +383,7 @@ seek (int fd, unsigned position)
 static unsigned
 tell (int fd)
 {
-  struct file_node *file_node
-      = get_file_node_by_fd (&thread_current ()->file_list, fd);
+  struct file_node *file_node = fdtable_get (fd);
   if (file_node)
     return file_tell (file_node->file);
   else
@@ -239,23 +393,14 @@ tell (int fd)
 static void
 close (int fd)
 {
-  struct list *file_list = &thread_current ()->file_list;
-  struct file_node *file_node = get_file_node_by_fd (file_list, fd);
-  if (!file_node)
+  if (!fdtable_close (fd))
     exit (-1);
-  if (file_node->is_dir)
-    dir_close (file_node->dir);
-  else
-    file_close (file_node->file);
-  list_remove (&file_node->elem);
-  free (file_node);
 }
 
 static int
 isdir (int fd)
 {
-  struct list *file_list = &thread_current ()->file_list;
-  struct file_node *file_node = get_file_node_by_fd (file_list, fd);
+  struct file_node *file_node = fdtable_get (fd);
   if (!file_node)
     exit (-1);
   return file_node->is_dir;
@@ -264,8 +409,7 @@ isdir (int fd)
 static int
 inumber (int fd)
 {
-  struct list *file_list = &thread_current ()->file_list;
-  struct file_node *file_node = get_file_node_by_fd (file_list, fd);
+  struct file_node *file_node = fdtable_get (fd);
   if (!file_node)
     exit (-1);
   if (file_node->is_dir)
@@ -277,59 +421,264 @@ inumber (int fd)
 static int
 readdir (int fd, char *name)
 {
-  struct list *file_list = &thread_current ()->file_list;
-  struct file_node *file_node = get_file_node_by_fd (file_list, fd);
+  struct file_node *file_node = fdtable_get (fd);
   if (!file_node)
     exit (-1);
   if (!file_node->is_dir)
     exit (-1);
-  check_buffer_put ((uint8_t *)name, NAME_MAX + 1);
-  return dir_readdir (file_node->dir, name);
+  char kname[NAME_MAX + 1];
+  int result = dir_readdir (file_node->dir, kname);
+  if (result && !copy_to_user (name, kname, strlen (kname) + 1))
+    exit (-1);
+  return result;
 }
 
 static int
 mkdir (const char *dir)
 {
-  if (!check_string (dir))
-    exit (-1);
+  char *kdir = copy_in_string (dir);
   // printf ("mkdir syscall: %s\n", dir);
-  return filesys_mkdir (dir);
+  int success = filesys_mkdir (kdir);
+  palloc_free_page (kdir);
+  return success;
 }
 
 static int
 chdir (const char *dir)
 {
-  if (!check_string (dir))
+  char *kdir = copy_in_string (dir);
+  int success = filesys_chdir (kdir);
+  palloc_free_page (kdir);
+  return success;
+}
+
+static void
+memstat (struct memstat *m)
+{
+  struct memstat km;
+  exception_get_stats (&km);
+  if (!copy_to_user (m, &km, sizeof km))
+    exit (-1);
+}
+
+/* Reads from FD into each of the IOVCNT buffers in IOV in turn,
+   stopping early at the first one that is not filled, and
+   returns the number of bytes read, or -1 if FD is not open. */
+static int
+readv (int fd, const struct iovec *iov, int iovcnt)
+{
+  struct iovec kiov[IOV_MAX];
+  if (iovcnt < 0 || iovcnt > IOV_MAX)
+    return -1;
+  if (!copy_from_user (kiov, iov, iovcnt * sizeof *kiov))
+    exit (-1);
+
+  int total = 0;
+  for (int i = 0; i < iovcnt; i++)
+    {
+      int result = read (fd, kiov[i].iov_base, kiov[i].iov_len);
+      if (result < 0)
+        return -1;
+      total += result;
+      if ((size_t)result < kiov[i].iov_len)
+        break;
+    }
+  return total;
+}
+
+/* Writes to FD from each of the IOVCNT buffers in IOV in turn,
+   stopping early at the first one that is not written in full,
+   and returns the number of bytes written, or -1 if FD is a
+   directory. */
+static int
+writev (int fd, const struct iovec *iov, int iovcnt)
+{
+  struct iovec kiov[IOV_MAX];
+  if (iovcnt < 0 || iovcnt > IOV_MAX)
+    return -1;
+  if (!copy_from_user (kiov, iov, iovcnt * sizeof *kiov))
+    exit (-1);
+
+  int total = 0;
+  for (int i = 0; i < iovcnt; i++)
+    {
+      int result = write (fd, kiov[i].iov_base, kiov[i].iov_len);
+      if (result < 0)
+        return -1;
+      total += result;
+      if ((size_t)result < kiov[i].iov_len)
+        break;
+    }
+  return total;
+}
+
+/* Reads SIZE bytes from FD at byte OFFSET into BUFFER without
+   moving FD's position, and returns the number of bytes read, or
+   -1 if FD is not an open file. */
+static int
+pread (int fd, void *buffer, unsigned size, unsigned offset)
+{
+  if (!check_user (buffer, size, true))
+    exit (-1);
+
+  struct file_node *file_node = fdtable_get (fd);
+  if (!file_node || file_node->is_dir || (off_t)offset < 0)
+    return -1;
+  pin_buffer (buffer, size, true);
+  int result = file_read_at (file_node->file, buffer, size, offset);
+  unpin_buffer (buffer, size);
+  return result;
+}
+
+/* Writes SIZE bytes from BUFFER to FD at byte OFFSET without
+   moving FD's position, and returns the number of bytes written,
+   or -1 if FD is not an open file. */
+static int
+pwrite (int fd, const void *buffer, unsigned size, unsigned offset)
+{
+  if (!check_user (buffer, size, false))
+    exit (-1);
+
+  struct file_node *file_node = fdtable_get (fd);
+  if (!file_node || file_node->is_dir || (off_t)offset < 0)
+    return -1;
+  pin_buffer (buffer, size, false);
+  int result = file_write_at (file_node->file, buffer, size, offset);
+  unpin_buffer (buffer, size);
+  return result;
+}
+
+/* Carries out request SQE from a submission ring and returns its
+   result. */
+static int
+ring_do (const struct ring_sqe *sqe)
+{
+  switch (sqe->op)
+    {
+    case RING_OP_OPEN:
+      return open (sqe->buf);
+    case RING_OP_CREATE:
+      return create (sqe->buf, sqe->len);
+    case RING_OP_READ:
+      return read (sqe->fd, sqe->buf, sqe->len);
+    case RING_OP_WRITE:
+      return write (sqe->fd, sqe->buf, sqe->len);
+    case RING_OP_CLOSE:
+      close (sqe->fd);
+      return 0;
+    default:
+      return -1;
+    }
+}
+
+/* Carries out up to TO_SUBMIT requests queued in RING's
+   submission ring, in order, posting their results to its
+   completion ring, and returns the number carried out.  Stops
+   early if the submission ring runs empty or the completion ring
+   fills up.  Only the ring heads and tails are written back, once
+   at the end, and the process must not touch them meanwhile. */
+static int
+ring_enter (struct ring *ring, unsigned to_submit)
+{
+  unsigned sq_head, sq_tail, cq_head, cq_tail;
+  if (!copy_from_user (&sq_head, &ring->sq.head, sizeof sq_head)
+      || !copy_from_user (&sq_tail, &ring->sq.tail, sizeof sq_tail)
+      || !copy_from_user (&cq_head, &ring->cq.head, sizeof cq_head)
+      || !copy_from_user (&cq_tail, &ring->cq.tail, sizeof cq_tail))
     exit (-1);
-  return filesys_chdir (dir);
+
+  unsigned done;
+  for (done = 0; done < to_submit && sq_head != sq_tail
+                 && cq_tail - cq_head < RING_SIZE;
+       done++)
+    {
+      struct ring_sqe sqe;
+      struct ring_cqe cqe;
+      if (!copy_from_user (&sqe, &ring->sq.entries[sq_head++ % RING_SIZE],
+                           sizeof sqe))
+        exit (-1);
+      cqe.user_data = sqe.user_data;
+      cqe.result = ring_do (&sqe);
+      if (!copy_to_user (&ring->cq.entries[cq_tail++ % RING_SIZE], &cqe,
+                         sizeof cqe))
+        exit (-1);
+    }
+
+  if (!copy_to_user (&ring->sq.head, &sq_head, sizeof sq_head)
+      || !copy_to_user (&ring->cq.tail, &cq_tail, sizeof cq_tail))
+    exit (-1);
+  return done;
+}
+
+#ifdef VM
+static mapid_t
+mmap (int fd, void *addr)
+{
+  struct file_node *file_node = fdtable_get (fd);
+  if (!file_node || file_node->is_dir)
+    return MAP_FAILED;
+  return mmap_map (file_node->file, addr);
 }
 
 static void
-syscall_handler (struct intr_frame *f UNUSED)
+munmap (mapid_t mapping)
+{
+  mmap_unmap (mapping);
+}
+
+static pid_t
+fork (void)
 {
-  // printf ("system call!\n");
-  // printf("esp%p\n", f->esp);
+  return process_fork (thread_current ()->syscall_frame);
+}
 
-  if (!check_int_get (f->esp))
+static void *
+sbrk (intptr_t increment)
+{
+  void *old_brk = page_sbrk (increment);
+  return old_brk != NULL ? old_brk : (void *) -1;
+}
+#else
+/* Without virtual memory there is no heap, but the user library's
+   malloc() is built into every program, so fail as if the heap
+   could not grow instead of killing the process. */
+static void *
+sbrk (intptr_t increment UNUSED)
+{
+  return (void *) -1;
+}
+#endif
+
+/* Calls the system call whose number and arguments GET_WORD
+   fetches from F, as words 0 and 1 through 4 respectively, and
+   stores its return value in F's eax.  Kills the process if
+   there is no such system call. */
+static void
+dispatch (struct intr_frame *f,
+          bool (*get_word) (struct intr_frame *, int i, int *word))
+{
+#ifdef VM
+  /* Page faults in the kernel need this to recognize stack
+     growth, and fork() to copy the user's registers. */
+  thread_current ()->syscall_frame = f;
+#endif
+
+  int syscall_id;
+  if (!get_word (f, 0, &syscall_id))
     exit (-1);
-  int syscall_id = *(int *)f->esp;
-  if (syscall_id < 0 || syscall_id >= 30)
+  if (syscall_id < 0 || syscall_id >= SYS_CNT)
     exit (-1);
 
   void *func = syscall_func[syscall_id];
   if (func == NULL)
     exit (-1);
   int arg_number = syscall_arg_number[syscall_id];
-  ASSERT (0 <= arg_number && arg_number <= 3);
+  ASSERT (0 <= arg_number && arg_number <= 4);
 
-  int args[3];
+  int args[4];
   for (int i = 0; i < arg_number; i++)
-    {
-      int *arg = (int *)f->esp + 1 + i;
-      if (!check_int_get (arg))
-        exit (-1);
-      args[i] = *arg;
-    }
+    if (!get_word (f, i + 1, &args[i]))
+      exit (-1);
 
   int return_value;
   if (arg_number == 0)
@@ -340,17 +689,72 @@ syscall_handler (struct intr_frame *f UNUSED)
     return_value = ((int (*) (int, int))func) (args[0], args[1]);
   else if (arg_number == 3)
     return_value = ((int (*) (int, int, int))func) (args[0], args[1], args[2]);
+  else if (arg_number == 4)
+    return_value = ((int (*) (int, int, int, int))func) (args[0], args[1],
+                                                         args[2], args[3]);
   else
     NOT_REACHED ();
 
   f->eax = return_value;
-  // printf ("end syscall\n");
+}
+
+/* Fetches word I of a system call made with "int $0x30", whose
+   number and arguments are on the user stack. */
+static bool
+get_stack_word (struct intr_frame *f, int i, int *word)
+{
+  return copy_from_user (word, (int *)f->esp + i, sizeof *word);
+}
+
+/* Fetches word I of a system call made with SYSENTER, whose
+   number and first three arguments are in registers and whose
+   fourth argument is on top of the user stack. */
+static bool
+get_reg_word (struct intr_frame *f, int i, int *word)
+{
+  if (i == 0)
+    *word = f->eax;
+  else if (i == 1)
+    *word = f->ebx;
+  else if (i == 2)
+    *word = f->esi;
+  else if (i == 3)
+    *word = f->edi;
+  else
+    return copy_from_user (word, f->esp, sizeof *word);
+  return true;
+}
+
+/* Handles a system call made with "int $0x30". */
+static void
+syscall_handler (struct intr_frame *f)
+{
+  dispatch (f, get_stack_word);
+}
+
+/* Handles a system call made with SYSENTER, whose number is in
+   eax and whose arguments are in registers.  Called from
+   sysenter_entry in sysenter.S. */
+void
+syscall_sysenter (struct intr_frame *f)
+{
+  dispatch (f, get_reg_word);
 }
 
 void
 syscall_init (void)
 {
   intr_register_int (0x30, 3, INTR_ON, syscall_handler, "syscall");
+  if (cpu_has (CPUID_SEP))
+    {
+      write_msr (MSR_SYSENTER_CS, SEL_KCSEG);
+      sysenter_esp0 = tss_get_esp0 ();
+      write_msr (MSR_SYSENTER_ESP, (uint32_t) (sysenter_stack
+                                               + sizeof sysenter_stack
+                                                 / sizeof *sysenter_stack));
+      write_msr (MSR_SYSENTER_EIP, (uint32_t) sysenter_entry);
+    }
+
   syscall_arg_number[SYS_HALT] = 0;
   syscall_func[SYS_HALT] = (void *)halt;
 
@@ -363,6 +767,9 @@ syscall_init (void)
   syscall_arg_number[SYS_WAIT] = 1;
   syscall_func[SYS_WAIT] = (void *)wait;
 
+  syscall_arg_number[SYS_WAITPID] = 3;
+  syscall_func[SYS_WAITPID] = (void *)waitpid;
+
   syscall_arg_number[SYS_CREATE] = 2;
   syscall_func[SYS_CREATE] = (void *)create;
 
@@ -392,6 +799,10 @@ syscall_init (void)
 
   syscall_arg_number[SYS_MMAP] = 2;
   syscall_arg_number[SYS_MUNMAP] = 1;
+#ifdef VM
+  syscall_func[SYS_MMAP] = (void *)mmap;
+  syscall_func[SYS_MUNMAP] = (void *)munmap;
+#endif
 
   syscall_arg_number[SYS_CHDIR] = 1;
   syscall_func[SYS_CHDIR] = (void *)chdir;
@@ -407,19 +818,30 @@ syscall_init (void)
 
   syscall_arg_number[SYS_INUMBER] = 1;
   syscall_func[SYS_INUMBER] = (void *)inumber;
-}
 
-static struct file_node *
-get_file_node_by_fd (struct list *file_list, int fd)
-{
-  struct list_elem *e;
-  struct file_node *f;
-  for (e = list_begin (file_list); e != list_end (file_list);
-       e = list_next (e))
-    {
-      f = list_entry (e, struct file_node, elem);
-      if (f->fd == fd)
-        return f;
-    }
-  return NULL;
+  syscall_arg_number[SYS_MEMSTAT] = 1;
+  syscall_func[SYS_MEMSTAT] = (void *)memstat;
+
+  syscall_arg_number[SYS_READV] = 3;
+  syscall_func[SYS_READV] = (void *)readv;
+
+  syscall_arg_number[SYS_WRITEV] = 3;
+  syscall_func[SYS_WRITEV] = (void *)writev;
+
+  syscall_arg_number[SYS_PREAD] = 4;
+  syscall_func[SYS_PREAD] = (void *)pread;
+
+  syscall_arg_number[SYS_PWRITE] = 4;
+  syscall_func[SYS_PWRITE] = (void *)pwrite;
+
+  syscall_arg_number[SYS_ENTER_RING] = 2;
+  syscall_func[SYS_ENTER_RING] = (void *)ring_enter;
+
+#ifdef VM
+  syscall_arg_number[SYS_FORK] = 0;
+  syscall_func[SYS_FORK] = (void *)fork;
+#endif
+
+  syscall_arg_number[SYS_SBRK] = 1;
+  syscall_func[SYS_SBRK] = (void *)sbrk;
 }
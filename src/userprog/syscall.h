@@ -1,6 +1,12 @@
 #ifndef USERPROG_SYSCALL_H
 #define USERPROG_SYSCALL_H
 
+struct intr_frame;
+
 void syscall_init (void);
+void syscall_sysenter (struct intr_frame *);
+
+/* Fast system call entry point, in sysenter.S. */
+void sysenter_entry (void);
 
 #endif /* userprog/syscall.h */
@@ -0,0 +1,686 @@
+#include "vm/frame.h"
+#include <debug.h>
+#include <string.h>
+#include "threads/malloc.h"
+#include "threads/palloc.h"
+#include "threads/synch.h"
+#include "threads/vaddr.h"
+#include "filesys/file.h"
+#include "userprog/exception.h"
+#include "userprog/pagedir.h"
+#include "vm/page.h"
+#include "vm/swap.h"
+
+/* The frame table records every frame of the user pool that
+   holds a page.  When the pool runs dry, a frame is taken from
+   some page chosen by the clock algorithm, which approximates
+   LRU using the accessed bits in the page tables.
+
+   Read-only pages of executables are shared: a frame holding
+   the contents of such a page is entered in the shared frame
+   table under the file's inode sector and the page's offset in
+   the file, and any process that later faults on the same page
+   of the same file maps the existing frame instead of reading
+   its own copy.
+
+   Every PAGE_ZERO page that has not been written is mapped to
+   the zero frame, a read-only frame of zeros that is never
+   evicted or freed.  Writing to such a page gives it a frame of
+   its own, as below.
+
+   Frames are also shared by fork(), which maps every page that
+   the parent has in memory into the child as well.  Writable
+   pages are then mapped read-only in both processes, and a
+   write to one faults and gives the writer its own copy.
+
+   Pages going to swap are written out in clusters: the victim is
+   evicted together with the pages of the same process that the
+   clock hand would reach next, in a single request to
+   consecutive swap slots, so that a fault on any of them can
+   read the others back along with it.
+
+   A frame is freed when the last page mapped to it goes away. */
+
+static struct list frames;              /* All frames in use. */
+static struct list_elem *hand;          /* Clock hand. */
+static struct hash shared_frames;       /* Frames that may be shared. */
+static struct frame zero_frame;         /* Frame of zeros. */
+
+/* Protects the frame table, the frame and swap state of every
+   page, and the present bits of user page table entries. */
+static struct lock frame_lock;
+
+/* Signaled, with frame_lock held, when a frame finishes being
+   evicted. */
+static struct condition eviction_done;
+
+static hash_hash_func shared_hash;
+static hash_less_func shared_less;
+
+/* Initializes the frame table. */
+void
+frame_init (void)
+{
+  list_init (&frames);
+  hand = list_end (&frames);
+  hash_init (&shared_frames, shared_hash, shared_less, NULL);
+
+  zero_frame.kpage = palloc_get_page (PAL_USER | PAL_ZERO);
+  if (zero_frame.kpage == NULL)
+    PANIC ("no memory for zero frame");
+  list_init (&zero_frame.pages);
+  zero_frame.pin_cnt = 0;
+  zero_frame.evicting = false;
+  zero_frame.shared = false;
+  lock_init_named (&frame_lock, "frame_lock");
+  cond_init (&eviction_done);
+}
+
+/* Returns a hash value for shared frame F. */
+static unsigned
+shared_hash (const struct hash_elem *f_, void *aux UNUSED)
+{
+  const struct frame *f = hash_entry (f_, struct frame, share_elem);
+  return hash_int (f->sector) ^ hash_int (f->ofs);
+}
+
+/* Returns true if shared frame A precedes shared frame B. */
+static bool
+shared_less (const struct hash_elem *a_, const struct hash_elem *b_,
+             void *aux UNUSED)
+{
+  const struct frame *a = hash_entry (a_, struct frame, share_elem);
+  const struct frame *b = hash_entry (b_, struct frame, share_elem);
+
+  if (a->sector != b->sector)
+    return a->sector < b->sector;
+  else if (a->ofs != b->ofs)
+    return a->ofs < b->ofs;
+  else
+    return a->read_bytes < b->read_bytes;
+}
+
+/* Returns the frame under the clock hand and advances the hand,
+   wrapping around at the end of the list. */
+static struct frame *
+clock_advance (void)
+{
+  struct frame *f;
+
+  if (hand == list_end (&frames))
+    hand = list_begin (&frames);
+  f = list_entry (hand, struct frame, elem);
+  hand = list_next (hand);
+  return f;
+}
+
+/* Returns true if any page mapped to frame F has been accessed
+   since the last call, and clears their accessed bits. */
+static bool
+test_and_clear_accessed (struct frame *f)
+{
+  bool accessed = false;
+  struct list_elem *e;
+
+  for (e = list_begin (&f->pages); e != list_end (&f->pages);
+       e = list_next (e))
+    {
+      struct page *p = list_entry (e, struct page, frame_elem);
+      if (pagedir_is_accessed (p->pagedir, p->upage))
+        {
+          pagedir_set_accessed (p->pagedir, p->upage, false);
+          accessed = true;
+        }
+    }
+  return accessed;
+}
+
+/* Chooses a frame to evict: the first unpinned frame under the
+   clock hand whose pages have not been accessed since the hand
+   last passed it.  Returns a null pointer if every frame is
+   pinned. */
+static struct frame *
+choose_victim (void)
+{
+  size_t i, cnt = list_size (&frames);
+
+  /* Two sweeps are enough, because the first clears every
+     accessed bit that it passes. */
+  for (i = 0; i < 2 * cnt; i++)
+    {
+      struct frame *f = clock_advance ();
+      if (f->pin_cnt == 0 && !test_and_clear_accessed (f))
+        return f;
+    }
+  return NULL;
+}
+
+/* Removes frame F from the shared frame table, if it is there,
+   so that no more pages will be mapped to it. */
+static void
+unshare (struct frame *f)
+{
+  if (f->shared)
+    {
+      hash_delete (&shared_frames, &f->share_elem);
+      f->shared = false;
+    }
+}
+
+/* Frees frame F if no page is mapped to it, unless it is the
+   zero frame.  frame_lock must be held. */
+static void
+free_if_unused (struct frame *f)
+{
+  if (list_empty (&f->pages) && f != &zero_frame)
+    {
+      unshare (f);
+      if (hand == &f->elem)
+        hand = list_next (hand);
+      list_remove (&f->elem);
+      palloc_free_page (f->kpage);
+      free (f);
+    }
+}
+
+/* Unmaps the pages in frame F, so that their owners cannot
+   modify them behind our back, and marks F as being evicted.
+   Returns true if any of the pages is dirty.  frame_lock must be
+   held. */
+static bool
+begin_eviction (struct frame *f)
+{
+  bool dirty = false;
+  struct list_elem *e;
+
+  for (e = list_begin (&f->pages); e != list_end (&f->pages);
+       e = list_next (e))
+    {
+      struct page *p = list_entry (e, struct page, frame_elem);
+      dirty = dirty || pagedir_is_dirty (p->pagedir, p->upage);
+      pagedir_clear_page (p->pagedir, p->upage);
+    }
+  unshare (f);
+  f->pin_cnt++;
+  f->evicting = true;
+  return dirty;
+}
+
+/* Detaches the pages from frame F, whose eviction is complete.
+   frame_lock must be held. */
+static void
+end_eviction (struct frame *f)
+{
+  while (!list_empty (&f->pages))
+    {
+      struct page *p = list_entry (list_pop_front (&f->pages),
+                                   struct page, frame_elem);
+      p->frame = NULL;
+    }
+  f->pin_cnt--;
+  f->evicting = false;
+}
+
+/* Adds to BATCH[], which holds only the frame being evicted, the
+   frames that can be written to swap along with it: those that
+   hold a single page of the same process, which has not been
+   accessed recently and would have to go to swap in turn.  Only
+   the frames that the clock hand is about to reach are
+   considered, since they would be evicted soon anyway.  The
+   frames added are unmapped and marked as being evicted.  Sorts
+   BATCH[] by user address, so that neighboring pages get
+   neighboring swap slots and can be read back together, and
+   returns the number of frames in it.  frame_lock must be held. */
+static size_t
+gather_swap_batch (struct frame *batch[])
+{
+  struct frame *f = batch[0];
+  struct page *p = list_entry (list_front (&f->pages), struct page,
+                               frame_elem);
+  struct list_elem *e = hand;
+  size_t cnt = 1;
+  int i;
+
+  for (i = 0; i < 4 * SWAP_CLUSTER && cnt < SWAP_CLUSTER; i++)
+    {
+      struct frame *g;
+      struct page *q;
+      size_t j;
+
+      if (e == list_end (&frames))
+        e = list_begin (&frames);
+      g = list_entry (e, struct frame, elem);
+      e = list_next (e);
+      if (g == f)
+        break;
+      if (g->pin_cnt > 0 || list_size (&g->pages) != 1)
+        continue;
+      q = list_entry (list_front (&g->pages), struct page, frame_elem);
+      if (q->pagedir != p->pagedir || q->type == PAGE_MMAP
+          || pagedir_is_accessed (q->pagedir, q->upage)
+          || (q->type != PAGE_SWAP
+              && !pagedir_is_dirty (q->pagedir, q->upage)))
+        continue;
+
+      begin_eviction (g);
+      for (j = cnt++; j > 0; j--)
+        {
+          struct page *r = list_entry (list_front (&batch[j - 1]->pages),
+                                       struct page, frame_elem);
+          if (r->upage < q->upage)
+            break;
+          batch[j] = batch[j - 1];
+        }
+      batch[j] = g;
+    }
+  return cnt;
+}
+
+/* Writes the CNT frames in BATCH[] to swap, in a single request
+   if swap has enough consecutive free slots, and makes their
+   pages PAGE_SWAP pages.  The pages in a frame share its slot. */
+static void
+swap_out_batch (struct frame *batch[], size_t cnt)
+{
+  void *kpages[SWAP_CLUSTER];
+  size_t slots[SWAP_CLUSTER];
+  size_t i;
+
+  for (i = 0; i < cnt; i++)
+    kpages[i] = batch[i]->kpage;
+  if (!swap_out_multi (kpages, cnt, slots))
+    PANIC ("out of swap space");
+
+  for (i = 0; i < cnt; i++)
+    {
+      struct list_elem *e;
+
+      for (e = list_begin (&batch[i]->pages);
+           e != list_end (&batch[i]->pages); e = list_next (e))
+        {
+          struct page *q = list_entry (e, struct page, frame_elem);
+          if (e != list_begin (&batch[i]->pages))
+            swap_dup (slots[i]);
+          q->swap_slot = slots[i];
+          q->type = PAGE_SWAP;
+        }
+    }
+}
+
+/* Evicts the pages in frame F.  The pages are unmapped at once,
+   but writing them out happens without holding frame_lock,
+   since writing back a mapped file needs file system locks that
+   a thread holding frame_lock must not wait for.  In the
+   meantime F is marked as being evicted, and anyone who wants
+   one of its pages must wait for eviction_done.
+
+   All the pages in a frame have the same type, since they are
+   either read-only executable pages or were copied by fork().
+   If they go to swap, they share a single slot.  Other pages of
+   the same process that would soon go to swap are evicted along
+   with them and written in the same request; their frames are
+   freed.  F itself is kept for the caller. */
+static void
+evict (struct frame *f)
+{
+  struct page *p = list_entry (list_front (&f->pages), struct page,
+                               frame_elem);
+  struct frame *batch[SWAP_CLUSTER];
+  size_t cnt = 1, i;
+  bool dirty;
+
+  ASSERT (lock_held_by_current_thread (&frame_lock));
+
+  dirty = begin_eviction (f);
+  batch[0] = f;
+  if (p->type != PAGE_MMAP && (dirty || p->type == PAGE_SWAP))
+    cnt = gather_swap_batch (batch);
+  lock_release (&frame_lock);
+  for (i = 0; i < cnt; i++)
+    exception_count (PAGING_EVICTION);
+
+  if (p->type == PAGE_MMAP)
+    {
+      if (dirty)
+        file_write_at (p->file, f->kpage, p->read_bytes, p->ofs);
+    }
+  else if (dirty || p->type == PAGE_SWAP)
+    swap_out_batch (batch, cnt);
+
+  lock_acquire (&frame_lock);
+  for (i = 0; i < cnt; i++)
+    {
+      end_eviction (batch[i]);
+      if (batch[i] != f)
+        free_if_unused (batch[i]);
+    }
+  cond_broadcast (&eviction_done, &frame_lock);
+}
+
+/* Waits until page P is not being evicted.  frame_lock must be
+   held. */
+static void
+wait_for_eviction (struct page *p)
+{
+  while (p->frame != NULL && p->frame->evicting)
+    cond_wait (&eviction_done, &frame_lock);
+}
+
+/* Maps page P to frame F and pins F.  frame_lock must be held. */
+static void
+attach (struct frame *f, struct page *p)
+{
+  list_push_back (&f->pages, &p->frame_elem);
+  f->pin_cnt++;
+  p->frame = f;
+}
+
+/* Allocates an empty frame from the user pool, without evicting
+   anything, and returns it.  Returns a null pointer if the pool
+   is exhausted.  frame_lock must be held. */
+static struct frame *
+new_frame (void)
+{
+  struct frame *f;
+  void *kpage;
+
+  kpage = palloc_get_page (PAL_USER);
+  if (kpage == NULL)
+    return NULL;
+  f = malloc (sizeof *f);
+  if (f == NULL)
+    {
+      palloc_free_page (kpage);
+      return NULL;
+    }
+  f->kpage = kpage;
+  list_init (&f->pages);
+  f->pin_cnt = 0;
+  f->evicting = false;
+  f->shared = false;
+  list_push_back (&frames, &f->elem);
+  return f;
+}
+
+/* Obtains an empty frame, evicting other pages if the user pool
+   is exhausted, and returns it.  Returns a null pointer if no
+   frame can be had.  frame_lock must be held, but it may be
+   released and reacquired in the meantime. */
+static struct frame *
+get_frame (void)
+{
+  struct frame *f = new_frame ();
+
+  if (f == NULL)
+    {
+      f = choose_victim ();
+      if (f != NULL)
+        evict (f);
+    }
+  return f;
+}
+
+/* Obtains a frame for page P, evicting other pages if the user
+   pool is exhausted, and returns it.  The frame is pinned, so
+   the caller can fill it in and map it before unpinning it.
+   Returns a null pointer if no frame can be had. */
+struct frame *
+frame_alloc (struct page *p)
+{
+  struct frame *f;
+
+  lock_acquire (&frame_lock);
+  wait_for_eviction (p);
+  ASSERT (p->frame == NULL);
+
+  f = get_frame ();
+  if (f != NULL)
+    attach (f, p);
+  lock_release (&frame_lock);
+  return f;
+}
+
+/* Gives each of the CNT pages in AHEAD[], which follow page P in
+   its process's address space, a pinned frame of its own to read
+   it into, as long as the page is in the swap slot that follows
+   the previous page's and a frame can be had without evicting
+   anything.  P must be in a pinned frame and in swap.  Returns
+   the number of pages, from the start of AHEAD[], that got
+   frames. */
+size_t
+frame_alloc_ahead (struct page *p, struct page *ahead[], size_t cnt)
+{
+  size_t i;
+
+  lock_acquire (&frame_lock);
+  ASSERT (p->frame != NULL && p->swap_slot != SWAP_ERROR);
+  for (i = 0; i < cnt; i++)
+    {
+      struct page *q = ahead[i];
+      struct frame *f;
+
+      if (q->frame != NULL || q->type != PAGE_SWAP
+          || q->swap_slot != p->swap_slot + i + 1)
+        break;
+      f = new_frame ();
+      if (f == NULL)
+        break;
+      attach (f, q);
+    }
+  lock_release (&frame_lock);
+  return i;
+}
+
+/* Looks for a shared frame that holds the contents of page P,
+   which must be a read-only PAGE_FILE page of the file whose
+   inode is at SECTOR.  If there is one, maps P to it, pins it,
+   and returns it.  Otherwise, returns a null pointer. */
+struct frame *
+frame_share (struct page *p, block_sector_t sector)
+{
+  struct frame key, *f = NULL;
+  struct hash_elem *e;
+
+  ASSERT (p->type == PAGE_FILE && !p->writable);
+
+  key.sector = sector;
+  key.ofs = p->ofs;
+  key.read_bytes = p->read_bytes;
+
+  lock_acquire (&frame_lock);
+  wait_for_eviction (p);
+  ASSERT (p->frame == NULL);
+  e = hash_find (&shared_frames, &key.share_elem);
+  if (e != NULL)
+    {
+      f = hash_entry (e, struct frame, share_elem);
+      attach (f, p);
+    }
+  lock_release (&frame_lock);
+  return f;
+}
+
+/* Maps page P, which must be a PAGE_ZERO page, to the zero frame
+   and returns it.  The caller must map P read-only. */
+struct frame *
+frame_zero (struct page *p)
+{
+  ASSERT (p->type == PAGE_ZERO);
+
+  lock_acquire (&frame_lock);
+  wait_for_eviction (p);
+  ASSERT (p->frame == NULL);
+  attach (&zero_frame, p);
+  lock_release (&frame_lock);
+  return &zero_frame;
+}
+
+/* Returns true if page P is in a frame, waiting first for any
+   eviction of it in progress to finish. */
+bool
+frame_present (struct page *p)
+{
+  bool present;
+
+  lock_acquire (&frame_lock);
+  wait_for_eviction (p);
+  present = p->frame != NULL;
+  lock_release (&frame_lock);
+  return present;
+}
+
+/* Enters page P's frame, which P has just filled in, in the
+   shared frame table so that other processes can map it.  P must
+   be a read-only PAGE_FILE page of the file whose inode is at
+   SECTOR.  Does nothing if another frame with the same contents
+   was entered first. */
+void
+frame_publish (struct page *p, block_sector_t sector)
+{
+  struct frame *f;
+
+  ASSERT (p->type == PAGE_FILE && !p->writable);
+
+  lock_acquire (&frame_lock);
+  f = p->frame;
+  ASSERT (f != NULL && !f->shared);
+  f->sector = sector;
+  f->ofs = p->ofs;
+  f->read_bytes = p->read_bytes;
+  f->shared = hash_insert (&shared_frames, &f->share_elem) == NULL;
+  lock_release (&frame_lock);
+}
+
+/* If page P is mapped to a frame, unmaps it, and frees the frame
+   if no other page is mapped to it. */
+void
+frame_release (struct page *p)
+{
+  struct frame *f;
+
+  lock_acquire (&frame_lock);
+  wait_for_eviction (p);
+  f = p->frame;
+  if (f != NULL)
+    {
+      pagedir_clear_page (p->pagedir, p->upage);
+      list_remove (&p->frame_elem);
+      p->frame = NULL;
+      free_if_unused (f);
+    }
+  lock_release (&frame_lock);
+}
+
+/* Makes child page C, a copy of parent page P made by fork(),
+   share P's frame and swap slot, if it has them.  If P is
+   writable, it is mapped read-only so that both P and C are
+   copied on their first write.  C's type is set to P's, which
+   becomes PAGE_SWAP if P has been modified in memory, since the
+   frame's contents can no longer be recreated from P's original
+   source.  Returns false if memory is exhausted. */
+bool
+frame_fork (struct page *p, struct page *c)
+{
+  struct frame *f;
+  bool success = true;
+
+  lock_acquire (&frame_lock);
+  wait_for_eviction (p);
+  f = p->frame;
+  if (f != NULL)
+    {
+      if (p->writable)
+        {
+          if (pagedir_is_dirty (p->pagedir, p->upage))
+            p->type = PAGE_SWAP;
+          pagedir_set_writable (p->pagedir, p->upage, false);
+        }
+      success = pagedir_set_page (c->pagedir, c->upage, f->kpage, false);
+      if (success)
+        {
+          list_push_back (&f->pages, &c->frame_elem);
+          c->frame = f;
+        }
+    }
+  else if (p->swap_slot != SWAP_ERROR)
+    {
+      swap_dup (p->swap_slot);
+      c->swap_slot = p->swap_slot;
+    }
+  c->type = p->type;
+  lock_release (&frame_lock);
+  return success;
+}
+
+/* Handles a write to writable page P while it is mapped
+   read-only because its frame is shared with another process or
+   is the zero frame.  Gives P a private copy of the frame, unless
+   it is the last page mapped to a frame other than the zero
+   frame, and maps it writable.  Does nothing if P is not in a
+   frame.  Returns false if memory is exhausted. */
+bool
+frame_unshare (struct page *p)
+{
+  struct frame *f, *copy;
+  bool success = true;
+
+  ASSERT (p->writable);
+
+  lock_acquire (&frame_lock);
+  wait_for_eviction (p);
+  f = p->frame;
+  if (f != NULL && (list_size (&f->pages) > 1 || f == &zero_frame))
+    {
+      /* Keep F while waiting for a frame to copy it into. */
+      f->pin_cnt++;
+      copy = get_frame ();
+      f->pin_cnt--;
+      if (copy != NULL)
+        {
+          memcpy (copy->kpage, f->kpage, PGSIZE);
+          pagedir_clear_page (p->pagedir, p->upage);
+          list_remove (&p->frame_elem);
+          list_push_back (&copy->pages, &p->frame_elem);
+          p->frame = copy;
+          pagedir_set_page (p->pagedir, p->upage, copy->kpage, true);
+          free_if_unused (f);
+        }
+      else
+        success = false;
+    }
+  else if (f != NULL)
+    pagedir_set_writable (p->pagedir, p->upage, true);
+  lock_release (&frame_lock);
+  return success;
+}
+
+/* If page P is mapped to a frame, pins the frame so that it will
+   not be evicted, and returns true.  Otherwise, returns false.
+   Each call must be balanced by a call to frame_unpin(). */
+bool
+frame_pin (struct page *p)
+{
+  bool pinned;
+
+  lock_acquire (&frame_lock);
+  wait_for_eviction (p);
+  pinned = p->frame != NULL;
+  if (pinned)
+    p->frame->pin_cnt++;
+  lock_release (&frame_lock);
+  return pinned;
+}
+
+/* Undoes one frame_pin() of page P's frame, if it has one.  P
+   must not be being evicted, which it cannot be while pinned. */
+void
+frame_unpin (struct page *p)
+{
+  lock_acquire (&frame_lock);
+  if (p->frame != NULL)
+    {
+      ASSERT (p->frame->pin_cnt > 0);
+      p->frame->pin_cnt--;
+    }
+  lock_release (&frame_lock);
+}
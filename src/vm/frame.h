@@ -0,0 +1,46 @@
+#ifndef VM_FRAME_H
+#define VM_FRAME_H
+
+#include <hash.h>
+#include <list.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include "devices/block.h"
+#include "filesys/off_t.h"
+
+struct page;
+
+/* A frame of physical memory from the user pool, holding a page
+   of virtual memory.  Usually the page belongs to a single
+   process, but a frame holding read-only executable text may be
+   mapped by every process running the same executable. */
+struct frame
+  {
+    void *kpage;                /* Kernel virtual address. */
+    struct list pages;          /* Pages mapped to the frame. */
+    unsigned pin_cnt;           /* Exempt from eviction if nonzero. */
+    bool evicting;              /* Are PAGES being written out? */
+    struct list_elem elem;      /* Element in frame list. */
+
+    /* Shared frames only. */
+    bool shared;                /* In the shared frame table? */
+    struct hash_elem share_elem; /* Element in shared frame table. */
+    block_sector_t sector;      /* Inode sector of the file read. */
+    off_t ofs;                  /* Offset in the file. */
+    size_t read_bytes;          /* Bytes read, the rest are zeroed. */
+  };
+
+void frame_init (void);
+struct frame *frame_alloc (struct page *);
+size_t frame_alloc_ahead (struct page *, struct page *ahead[], size_t cnt);
+struct frame *frame_share (struct page *, block_sector_t sector);
+struct frame *frame_zero (struct page *);
+bool frame_present (struct page *);
+void frame_publish (struct page *, block_sector_t sector);
+void frame_release (struct page *);
+bool frame_fork (struct page *, struct page *);
+bool frame_unshare (struct page *);
+bool frame_pin (struct page *);
+void frame_unpin (struct page *);
+
+#endif /* vm/frame.h */
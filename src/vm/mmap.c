@@ -0,0 +1,124 @@
+#include "vm/mmap.h"
+#include <debug.h>
+#include <round.h>
+#include "filesys/file.h"
+#include "threads/malloc.h"
+#include "threads/thread.h"
+#include "threads/vaddr.h"
+#include "vm/page.h"
+
+/* A mapping's pages are ordinary PAGE_MMAP pages in the
+   process's supplemental page table, so they are read in from
+   the file, through the buffer cache, only when first touched.
+   A page is written back only if its dirty bit says that it was
+   modified: when it is evicted, and when it is unmapped. */
+
+/* Removes the first CNT pages of mapping M from the current
+   process's page table. */
+static void
+remove_pages (struct mapping *m, size_t cnt)
+{
+  size_t i;
+
+  for (i = 0; i < cnt; i++)
+    {
+      struct page *p = page_lookup ((uint8_t *) m->addr + i * PGSIZE);
+      ASSERT (p != NULL);
+      page_remove (p);
+    }
+}
+
+/* Maps FILE into the current process's address space starting
+   at ADDR, which must be page-aligned and nonnull, and returns
+   the new mapping's identifier.  The mapping uses its own handle
+   on FILE, so it outlives FILE being closed.  Fails, returning
+   MAP_FAILED, if FILE is empty or if any page of the mapping
+   would overlap a page that is already in use, the heap, or the
+   region reserved for the stack. */
+mapid_t
+mmap_map (struct file *file, void *addr)
+{
+  struct thread *t = thread_current ();
+  struct mapping *m;
+  off_t length = file_length (file);
+  size_t i;
+
+  if (addr == NULL || pg_ofs (addr) != 0 || !is_user_vaddr (addr)
+      || length == 0 || length > (uint8_t *) PHYS_BASE - (uint8_t *) addr
+      || page_is_stack ((uint8_t *) addr + length - 1)
+      || ((uint8_t *) addr < t->heap_brk
+          && (uint8_t *) addr + length > t->heap_start))
+    return MAP_FAILED;
+
+  m = malloc (sizeof *m);
+  if (m == NULL)
+    return MAP_FAILED;
+  m->file = file_reopen (file);
+  if (m->file == NULL)
+    {
+      free (m);
+      return MAP_FAILED;
+    }
+  m->addr = addr;
+  m->page_cnt = DIV_ROUND_UP (length, PGSIZE);
+
+  for (i = 0; i < m->page_cnt; i++)
+    {
+      off_t ofs = i * PGSIZE;
+      size_t read_bytes = length - ofs < PGSIZE ? length - ofs : PGSIZE;
+
+      if (page_add_mmap ((uint8_t *) addr + ofs, m->file, ofs,
+                         read_bytes) == NULL)
+        {
+          remove_pages (m, i);
+          file_close (m->file);
+          free (m);
+          return MAP_FAILED;
+        }
+    }
+
+  m->id = t->next_mapid++;
+  list_push_back (&t->mappings, &m->elem);
+  return m->id;
+}
+
+/* Unmaps mapping M, writing back its modified pages. */
+static void
+unmap (struct mapping *m)
+{
+  list_remove (&m->elem);
+  remove_pages (m, m->page_cnt);
+  file_close (m->file);
+  free (m);
+}
+
+/* Unmaps the current process's mapping with identifier MAPPING,
+   if there is one, writing back its modified pages. */
+void
+mmap_unmap (mapid_t mapping)
+{
+  struct list *mappings = &thread_current ()->mappings;
+  struct list_elem *e;
+
+  for (e = list_begin (mappings); e != list_end (mappings);
+       e = list_next (e))
+    {
+      struct mapping *m = list_entry (e, struct mapping, elem);
+      if (m->id == mapping)
+        {
+          unmap (m);
+          return;
+        }
+    }
+}
+
+/* Unmaps all of the current process's mappings.  Must be called
+   before the process's page table is destroyed. */
+void
+mmap_unmap_all (void)
+{
+  struct list *mappings = &thread_current ()->mappings;
+
+  while (!list_empty (mappings))
+    unmap (list_entry (list_front (mappings), struct mapping, elem));
+}
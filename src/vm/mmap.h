@@ -0,0 +1,26 @@
+#ifndef VM_MMAP_H
+#define VM_MMAP_H
+
+#include <list.h>
+
+struct file;
+
+/* Map region identifier. */
+typedef int mapid_t;
+#define MAP_FAILED ((mapid_t) -1)
+
+/* A file mapped into a process's address space. */
+struct mapping
+  {
+    struct list_elem elem;      /* Element in thread's mapping list. */
+    mapid_t id;                 /* Mapping identifier. */
+    struct file *file;          /* The process's own handle on the file. */
+    void *addr;                 /* First mapped page. */
+    size_t page_cnt;            /* Number of mapped pages. */
+  };
+
+mapid_t mmap_map (struct file *, void *addr);
+void mmap_unmap (mapid_t);
+void mmap_unmap_all (void);
+
+#endif /* vm/mmap.h */
@@ -0,0 +1,552 @@
+#include "vm/page.h"
+#include <debug.h>
+#include <string.h>
+#include "filesys/file.h"
+#include "filesys/inode.h"
+#include "threads/interrupt.h"
+#include "threads/malloc.h"
+#include "threads/pte.h"
+#include "threads/thread.h"
+#include "threads/vaddr.h"
+#include "userprog/exception.h"
+#include "userprog/pagedir.h"
+#include "vm/frame.h"
+#include "vm/swap.h"
+
+/* Maximum size of a process's stack, in bytes.  Stack pages are
+   only added as the stack grows down into this region. */
+size_t page_stack_max = 8 * 1024 * 1024;
+
+/* Returns a hash value for page P. */
+static unsigned
+page_hash (const struct hash_elem *p_, void *aux UNUSED)
+{
+  const struct page *p = hash_entry (p_, struct page, hash_elem);
+  return hash_bytes (&p->upage, sizeof p->upage);
+}
+
+/* Returns true if page A precedes page B. */
+static bool
+page_less (const struct hash_elem *a_, const struct hash_elem *b_,
+           void *aux UNUSED)
+{
+  const struct page *a = hash_entry (a_, struct page, hash_elem);
+  const struct page *b = hash_entry (b_, struct page, hash_elem);
+  return a->upage < b->upage;
+}
+
+/* Creates and returns an empty supplemental page table, or a
+   null pointer if memory allocation fails. */
+struct hash *
+page_table_create (void)
+{
+  struct hash *pages = malloc (sizeof *pages);
+  if (pages != NULL && !hash_init (pages, page_hash, page_less, NULL))
+    {
+      free (pages);
+      pages = NULL;
+    }
+  return pages;
+}
+
+/* Frees page P, along with its frame or swap slot.  If P is a
+   PAGE_MMAP page that was modified since it was read, writes it
+   back to its file first. */
+static void
+page_free (struct page *p)
+{
+  if (p->type == PAGE_MMAP && frame_pin (p)
+      && pagedir_is_dirty (p->pagedir, p->upage))
+    file_write_at (p->file, p->frame->kpage, p->read_bytes, p->ofs);
+  frame_release (p);
+  if (p->swap_slot != SWAP_ERROR)
+    swap_free (p->swap_slot);
+  free (p);
+}
+
+/* Frees page P_, for hash_destroy(). */
+static void
+page_destroy (struct hash_elem *p_, void *aux UNUSED)
+{
+  page_free (hash_entry (p_, struct page, hash_elem));
+}
+
+/* Destroys supplemental page table PAGES, which may be a null
+   pointer.  The page directory that its pages are mapped in
+   must still exist. */
+void
+page_table_destroy (struct hash *pages)
+{
+  if (pages != NULL)
+    {
+      hash_destroy (pages, page_destroy);
+      free (pages);
+    }
+}
+
+/* Adds a page at UPAGE to the current process's page table, of
+   the given TYPE and WRITABLE-ity, and returns it.  Returns a
+   null pointer if UPAGE is already in the table or if memory
+   allocation fails. */
+static struct page *
+page_add (void *upage, enum page_type type, bool writable)
+{
+  struct thread *t = thread_current ();
+  struct page *p;
+
+  ASSERT (pg_ofs (upage) == 0);
+  ASSERT (is_user_vaddr (upage));
+
+  p = malloc (sizeof *p);
+  if (p == NULL)
+    return NULL;
+  p->upage = upage;
+  p->pagedir = t->pagedir;
+  p->writable = writable;
+  p->type = type;
+  p->frame = NULL;
+  p->swap_slot = SWAP_ERROR;
+  p->file = NULL;
+  p->ofs = 0;
+  p->read_bytes = 0;
+
+  if (hash_insert (t->pages, &p->hash_elem) != NULL)
+    {
+      free (p);
+      return NULL;
+    }
+  return p;
+}
+
+/* Adds copies of the pages in PARENT, the page table of the
+   process that is forking the current one, to the current
+   process's page table.  Pages in memory or in swap are shared
+   with the parent until one of them writes to them.  Mapped
+   files are not copied.  Read-only file pages are read from
+   FILE, the current process's handle on the parent's
+   executable.  Returns true if successful, false if memory is
+   exhausted. */
+bool
+page_table_copy (struct hash *parent, struct file *file)
+{
+  struct hash_iterator i;
+
+  hash_first (&i, parent);
+  while (hash_next (&i))
+    {
+      struct page *p = hash_entry (hash_cur (&i), struct page, hash_elem);
+      struct page *c;
+
+      if (p->type == PAGE_MMAP)
+        continue;
+      c = page_add (p->upage, p->type, p->writable);
+      if (c == NULL)
+        return false;
+      c->file = file;
+      c->ofs = p->ofs;
+      c->read_bytes = p->read_bytes;
+      if (!frame_fork (p, c))
+        return false;
+    }
+  return true;
+}
+
+/* Adds a page at UPAGE to the current process's page table
+   whose first READ_BYTES bytes are read from FILE starting at
+   offset OFS and whose remaining bytes are zeroed.  FILE must
+   stay open as long as the page exists.  Returns the new page,
+   or a null pointer on failure. */
+struct page *
+page_add_file (void *upage, struct file *file, off_t ofs,
+               size_t read_bytes, bool writable)
+{
+  struct page *p;
+
+  ASSERT (read_bytes <= PGSIZE);
+
+  p = page_add (upage, PAGE_FILE, writable);
+  if (p != NULL)
+    {
+      p->file = file;
+      p->ofs = ofs;
+      p->read_bytes = read_bytes;
+    }
+  return p;
+}
+
+/* Adds a zero-filled page at UPAGE to the current process's page
+   table.  Returns the new page, or a null pointer on failure. */
+struct page *
+page_add_zero (void *upage, bool writable)
+{
+  return page_add (upage, PAGE_ZERO, writable);
+}
+
+/* Adds a writable page at UPAGE to the current process's page
+   table that maps READ_BYTES bytes of FILE starting at offset
+   OFS.  The rest of the page is zeroed and never written back.
+   FILE must stay open as long as the page exists.  Returns the
+   new page, or a null pointer on failure. */
+struct page *
+page_add_mmap (void *upage, struct file *file, off_t ofs,
+               size_t read_bytes)
+{
+  struct page *p = page_add_file (upage, file, ofs, read_bytes, true);
+  if (p != NULL)
+    p->type = PAGE_MMAP;
+  return p;
+}
+
+/* Returns the page in the current process's page table that
+   contains UADDR, or a null pointer if there is none. */
+struct page *
+page_lookup (const void *uaddr)
+{
+  struct thread *t = thread_current ();
+  struct page p;
+  struct hash_elem *e;
+
+  if (t->pages == NULL)
+    return NULL;
+  p.upage = pg_round_down (uaddr);
+  e = hash_find (t->pages, &p.hash_elem);
+  return e != NULL ? hash_entry (e, struct page, hash_elem) : NULL;
+}
+
+/* Returns true if UADDR is in the region of user virtual memory
+   reserved for the stack. */
+bool
+page_is_stack (const void *uaddr)
+{
+  return (is_user_vaddr (uaddr)
+          && (size_t) ((uint8_t *) PHYS_BASE - (uint8_t *) uaddr)
+             <= page_stack_max);
+}
+
+/* Returns true if UADDR is in the current process's heap. */
+static bool
+is_heap (const void *uaddr)
+{
+  struct thread *t = thread_current ();
+  return ((const uint8_t *) uaddr >= t->heap_start
+          && (const uint8_t *) uaddr < t->heap_brk);
+}
+
+/* Moves the end of the current process's heap, its "break", by
+   INCREMENT bytes and returns the old break.  The heap's pages
+   are added as zeroed pages only when first touched, like the
+   stack's, and pages that end up wholly above the new break are
+   freed.  Returns a null pointer, leaving the break alone, if the
+   heap would shrink below its start or grow over a mapped file
+   or into the region reserved for the stack. */
+void *
+page_sbrk (intptr_t increment)
+{
+  struct thread *t = thread_current ();
+  uint8_t *old_brk = t->heap_brk;
+  uint8_t *new_brk = old_brk + increment;
+  uint8_t *upage;
+
+  if (t->heap_start == NULL)
+    return NULL;
+  if (increment >= 0)
+    {
+      uint8_t *limit = (uint8_t *) PHYS_BASE - page_stack_max;
+      if ((size_t) increment > (size_t) (limit - old_brk))
+        return NULL;
+      for (upage = pg_round_up (old_brk); upage < new_brk; upage += PGSIZE)
+        if (page_lookup (upage) != NULL)
+          return NULL;
+    }
+  else
+    {
+      if ((size_t) -increment > (size_t) (old_brk - t->heap_start))
+        return NULL;
+      for (upage = pg_round_up (new_brk); upage < old_brk; upage += PGSIZE)
+        {
+          struct page *p = page_lookup (upage);
+          if (p != NULL)
+            page_remove (p);
+        }
+    }
+  t->heap_brk = new_brk;
+  return old_brk;
+}
+
+/* Handles a write fault at FAULT_ADDR on a page that is mapped
+   read-only because it is shared with a process that forked
+   from or was forked by the current one, by giving the current
+   process its own copy.  Returns false if FAULT_ADDR is not in a
+   writable page or if memory is exhausted. */
+bool
+page_copy_on_write (const void *fault_addr)
+{
+  struct page *p = page_lookup (fault_addr);
+
+  if (p == NULL || !p->writable || !frame_unshare (p))
+    return false;
+  exception_count (PAGING_MINOR_FAULT);
+  return true;
+}
+
+/* Returns the page in the current process's page table that
+   contains UADDR.  If there is none, but UADDR is in the heap or
+   looks like an access to the stack given user stack pointer
+   ESP, adds a zeroed page for UADDR and returns it.  Otherwise,
+   returns a null pointer.
+
+   An access below ESP is a stack access only if it is within 32
+   bytes of it, because PUSHA checks access permissions 32 bytes
+   below the stack pointer before decrementing it. */
+static struct page *
+lookup_or_grow (const void *uaddr, const void *esp)
+{
+  struct page *p = page_lookup (uaddr);
+
+  if (p == NULL
+      && (is_heap (uaddr)
+          || (page_is_stack (uaddr)
+              && (const uint8_t *) uaddr >= (const uint8_t *) esp - 32)))
+    p = page_add_zero (pg_round_down (uaddr), true);
+  return p;
+}
+
+/* Removes page P from the current process's page table and
+   frees it, writing it back first if it is a modified PAGE_MMAP
+   page. */
+void
+page_remove (struct page *p)
+{
+  hash_delete (thread_current ()->pages, &p->hash_elem);
+  page_free (p);
+}
+
+/* Fills KPAGE with the contents of page P.  Returns true if
+   successful, false if the page cannot be read. */
+static bool
+page_fill (struct page *p, uint8_t *kpage)
+{
+  switch (p->type)
+    {
+    case PAGE_FILE:
+    case PAGE_MMAP:
+      if (file_read_at (p->file, kpage, p->read_bytes, p->ofs)
+          != (off_t) p->read_bytes)
+        return false;
+      memset (kpage + p->read_bytes, 0, PGSIZE - p->read_bytes);
+      break;
+
+    case PAGE_ZERO:
+      memset (kpage, 0, PGSIZE);
+      break;
+
+    case PAGE_SWAP:
+      swap_in (p->swap_slot, kpage);
+      p->swap_slot = SWAP_ERROR;
+      break;
+    }
+  return true;
+}
+
+/* Reads page P, which must be in swap, into KPAGE, together with
+   the pages that follow P in the same page table and went to the
+   swap slots that follow P's, as happens when pages are evicted
+   together.  Pages are only read ahead into free frames.  They
+   are stored in AHEAD[], which must have room for SWAP_CLUSTER -
+   1 pages, and are left pinned but not mapped, still holding
+   their swap slots.  Returns the number of pages read ahead. */
+static size_t
+page_swap_in (struct page *p, uint8_t *kpage, struct page *ahead[])
+{
+  void *kpages[SWAP_CLUSTER];
+  uint8_t *upage = p->upage;
+  size_t cnt = 0, i;
+
+  while (cnt < SWAP_CLUSTER - 1)
+    {
+      upage += PGSIZE;
+      if (pd_no (upage) != pd_no (p->upage)
+          || (ahead[cnt] = page_lookup (upage)) == NULL)
+        break;
+      cnt++;
+    }
+  cnt = frame_alloc_ahead (p, ahead, cnt);
+
+  kpages[0] = kpage;
+  for (i = 0; i < cnt; i++)
+    kpages[i + 1] = ahead[i]->frame->kpage;
+  swap_read (p->swap_slot, kpages, cnt + 1);
+  swap_free (p->swap_slot);
+  p->swap_slot = SWAP_ERROR;
+  return cnt;
+}
+
+/* Maps the CNT pages in AHEAD[], which were read ahead by
+   page_swap_in(), if MAP is true and it is possible, and unpins
+   them.  A page that is not mapped is dropped, leaving it in
+   swap. */
+static void
+page_finish_ahead (struct page *ahead[], size_t cnt, bool map)
+{
+  size_t i;
+
+  for (i = 0; i < cnt; i++)
+    {
+      struct page *q = ahead[i];
+      if (map && pagedir_set_page (q->pagedir, q->upage, q->frame->kpage,
+                                   q->writable))
+        {
+          swap_free (q->swap_slot);
+          q->swap_slot = SWAP_ERROR;
+          frame_unpin (q);
+        }
+      else
+        {
+          frame_unpin (q);
+          frame_release (q);
+        }
+    }
+}
+
+/* Brings page P, which must not be in memory, into a frame and
+   maps it.  Leaves the frame pinned.  Returns true if
+   successful, false if memory is exhausted or the page cannot
+   be read.
+
+   A read-only page of a file, which in practice is executable
+   text, is mapped to the frame of another process's copy of the
+   same page if there is one, and otherwise its frame is offered
+   for other processes to share.
+
+   Unless the page is being brought in to be written, as WRITE
+   says, a PAGE_ZERO page is mapped read-only to the shared zero
+   frame, and only gets a frame of its own when it is first
+   written.
+
+   A page in swap is read along with the pages that were swapped
+   out next to it, which are mapped as well.
+
+   Counts a minor fault if no I/O was needed, otherwise a major
+   fault. */
+static bool
+page_in (struct page *p, bool write)
+{
+  bool shareable = p->type == PAGE_FILE && !p->writable;
+  bool writable = p->writable;
+  bool major = false;
+  block_sector_t sector = 0;
+  struct frame *f = NULL;
+  struct page *ahead[SWAP_CLUSTER - 1];
+  size_t ahead_cnt = 0;
+
+  if (shareable)
+    {
+      sector = inode_get_inumber (file_get_inode (p->file));
+      f = frame_share (p, sector);
+    }
+  else if (p->type == PAGE_ZERO && !write)
+    {
+      f = frame_zero (p);
+      writable = false;
+    }
+  if (f == NULL)
+    {
+      f = frame_alloc (p);
+      if (f == NULL)
+        return false;
+      major = p->type != PAGE_ZERO;
+      if (p->type == PAGE_SWAP)
+        ahead_cnt = page_swap_in (p, f->kpage, ahead);
+      else if (!page_fill (p, f->kpage))
+        goto fail;
+      if (shareable)
+        frame_publish (p, sector);
+    }
+
+  /* Map P first, since that creates the page table that the
+     pages read ahead of it are mapped into. */
+  if (!pagedir_set_page (p->pagedir, p->upage, f->kpage, writable))
+    goto fail;
+  page_finish_ahead (ahead, ahead_cnt, true);
+  exception_count (major ? PAGING_MAJOR_FAULT : PAGING_MINOR_FAULT);
+  return true;
+
+ fail:
+  page_finish_ahead (ahead, ahead_cnt, false);
+  frame_unpin (p);
+  frame_release (p);
+  return false;
+}
+
+/* Brings the page containing FAULT_ADDR into memory and maps it
+   into the current process's page directory, growing the stack
+   if FAULT_ADDR is a stack access given user stack pointer ESP.
+   WRITE says whether the faulting access was a write.  Returns
+   true if successful, false if FAULT_ADDR is not in a page that
+   the process may access or if memory is exhausted. */
+bool
+page_load (const void *fault_addr, const void *esp, bool write)
+{
+  struct page *p = lookup_or_grow (fault_addr, esp);
+
+  /* Eviction unmaps a page before writing it out, so a fault can
+     race with it; wait for it before checking whether the page is
+     already in memory. */
+  if (p == NULL)
+    return false;
+  if (frame_present (p))
+    return true;
+  if (!page_in (p, write))
+    return false;
+  frame_unpin (p);
+  return true;
+}
+
+/* Brings the pages spanning the SIZE bytes at UADDR into memory
+   and pins them there, so that the kernel can access them
+   without faulting, e.g. while it holds locks that the fault
+   handler might need.  The buffer may extend into stack pages
+   that have not been touched yet, which are added as if the
+   process had faulted on them.  If the kernel is to WRITE to the
+   buffer, pages shared copy-on-write are copied first.  Returns
+   true if successful.  On failure, leaves no page pinned. */
+bool
+page_pin_buffer (const void *uaddr, size_t size, bool write)
+{
+  const uint8_t *start = pg_round_down (uaddr);
+  const uint8_t *end = (const uint8_t *) uaddr + size;
+  const void *esp = thread_current ()->syscall_frame->esp;
+  const uint8_t *upage;
+
+  if (size == 0)
+    return true;
+  for (upage = start; upage < end; upage += PGSIZE)
+    {
+      const void *addr = upage == start ? uaddr : upage;
+      struct page *p = lookup_or_grow (addr, esp);
+      if (p == NULL || (write && (!p->writable || !frame_unshare (p)))
+          || (!frame_pin (p) && !page_in (p, write)))
+        {
+          page_unpin_buffer (start, upage - start);
+          return false;
+        }
+    }
+  return true;
+}
+
+/* Unpins the pages spanning the SIZE bytes at UADDR. */
+void
+page_unpin_buffer (const void *uaddr, size_t size)
+{
+  const uint8_t *end = (const uint8_t *) uaddr + size;
+  const uint8_t *upage;
+
+  if (size == 0)
+    return;
+  for (upage = pg_round_down (uaddr); upage < end; upage += PGSIZE)
+    {
+      struct page *p = page_lookup (upage);
+      if (p != NULL)
+        frame_unpin (p);
+    }
+}
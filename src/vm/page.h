@@ -0,0 +1,79 @@
+#ifndef VM_PAGE_H
+#define VM_PAGE_H
+
+#include <hash.h>
+#include <list.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "filesys/off_t.h"
+
+struct frame;
+
+/* Maximum size of a process's stack, in bytes. */
+extern size_t page_stack_max;
+
+/* Where the contents of a page come from when it is first
+   touched. */
+enum page_type
+  {
+    PAGE_FILE,                  /* Read from a file, rest zeroed. */
+    PAGE_ZERO,                  /* All zeros. */
+    PAGE_SWAP,                  /* Modified: in memory or in swap. */
+    PAGE_MMAP                   /* Mapped file, written back to it. */
+  };
+
+/* A page of user virtual memory, as recorded in its process's
+   supplemental page table.  A page need not be in memory: the
+   page table records how to bring it in on first touch, and
+   where it went if it was evicted.
+
+   Until it is first written, a PAGE_ZERO page is mapped to a
+   single read-only frame of zeros shared by every process.
+
+   A PAGE_FILE or PAGE_ZERO page that is evicted while clean is
+   simply dropped, since it can be read or zeroed again.  Once
+   evicted while dirty, it becomes a PAGE_SWAP page, whose only
+   copy is in its frame or in swap.
+
+   A PAGE_MMAP page is read like a PAGE_FILE page, but if it is
+   dirty when it is evicted or unmapped then it is written back
+   to its file instead of to swap. */
+struct page
+  {
+    struct hash_elem hash_elem; /* Element in thread's page table. */
+    void *upage;                /* User virtual address. */
+    uint32_t *pagedir;          /* Page directory that maps UPAGE. */
+    bool writable;              /* May the process write the page? */
+    enum page_type type;        /* Source of the page's contents. */
+
+    /* Protected by the frame table's lock. */
+    struct frame *frame;        /* Frame holding the page, if any. */
+    struct list_elem frame_elem; /* Element in frame's page list. */
+    size_t swap_slot;           /* Swap slot, or SWAP_ERROR if none. */
+
+    /* PAGE_FILE and PAGE_MMAP only. */
+    struct file *file;          /* File to read. */
+    off_t ofs;                  /* Offset in FILE. */
+    size_t read_bytes;          /* Bytes to read, the rest are zeroed. */
+  };
+
+struct hash *page_table_create (void);
+void page_table_destroy (struct hash *);
+bool page_table_copy (struct hash *parent, struct file *);
+
+struct page *page_add_file (void *upage, struct file *, off_t,
+                            size_t read_bytes, bool writable);
+struct page *page_add_zero (void *upage, bool writable);
+struct page *page_add_mmap (void *upage, struct file *, off_t,
+                            size_t read_bytes);
+struct page *page_lookup (const void *uaddr);
+bool page_is_stack (const void *uaddr);
+void *page_sbrk (intptr_t increment);
+void page_remove (struct page *);
+bool page_load (const void *fault_addr, const void *esp, bool write);
+bool page_copy_on_write (const void *fault_addr);
+bool page_pin_buffer (const void *, size_t, bool write);
+void page_unpin_buffer (const void *, size_t);
+
+#endif /* vm/page.h */
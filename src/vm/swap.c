@@ -0,0 +1,160 @@
+#include "vm/swap.h"
+#include <bitmap.h>
+#include <debug.h>
+#include <stdint.h>
+#include <stdio.h>
+#include "devices/block.h"
+#include "threads/malloc.h"
+#include "threads/synch.h"
+#include "threads/vaddr.h"
+#include "userprog/exception.h"
+
+/* Swap space is divided into page-sized slots on the block
+   device that plays the BLOCK_SWAP role. */
+
+/* Number of sectors per page. */
+#define PAGE_SECTORS (PGSIZE / BLOCK_SECTOR_SIZE)
+
+static struct block *swap_device;       /* Swap device, or null. */
+static struct bitmap *used_slots;       /* Bit set for each slot in use. */
+static uint16_t *ref_cnts;              /* Pages sharing each slot in use. */
+static struct lock swap_lock;           /* Protects USED_SLOTS, REF_CNTS. */
+
+/* Sets up swap space on the swap device, if there is one.
+   Without one, every swap_out() fails. */
+void
+swap_init (void)
+{
+  size_t slot_cnt = 0;
+
+  swap_device = block_get_role (BLOCK_SWAP);
+  if (swap_device != NULL)
+    slot_cnt = block_size (swap_device) / PAGE_SECTORS;
+  else
+    printf ("swap: no swap device, running without swap\n");
+
+  used_slots = bitmap_create (slot_cnt);
+  ref_cnts = calloc (slot_cnt + 1, sizeof *ref_cnts);
+  if (used_slots == NULL || ref_cnts == NULL)
+    PANIC ("swap: bitmap creation failed");
+  lock_init_named (&swap_lock, "swap_lock");
+}
+
+/* Transfers the CNT pages at KPAGES[] to (if WRITE is true) or
+   from the CNT consecutive slots starting at SLOT, as a single
+   block request. */
+static void
+transfer (size_t slot, void *const kpages[], size_t cnt, bool write)
+{
+  void *buffers[SWAP_CLUSTER * PAGE_SECTORS];
+  size_t i, j;
+
+  ASSERT (cnt <= SWAP_CLUSTER);
+  for (i = 0; i < cnt; i++)
+    for (j = 0; j < PAGE_SECTORS; j++)
+      buffers[i * PAGE_SECTORS + j] = (uint8_t *) kpages[i]
+                                      + j * BLOCK_SECTOR_SIZE;
+  if (write)
+    block_writev (swap_device, slot * PAGE_SECTORS, cnt * PAGE_SECTORS,
+                  (const void *const *) buffers);
+  else
+    block_readv (swap_device, slot * PAGE_SECTORS, cnt * PAGE_SECTORS,
+                 buffers);
+}
+
+/* Writes the page at KPAGE to a free swap slot and returns the
+   slot, or SWAP_ERROR if swap is full.  The slot starts out with
+   one reference. */
+size_t
+swap_out (const void *kpage)
+{
+  size_t slot;
+  if (!swap_out_multi ((void *const *) &kpage, 1, &slot))
+    return SWAP_ERROR;
+  return slot;
+}
+
+/* Writes the CNT pages at KPAGES[], at most SWAP_CLUSTER of
+   them, to free swap slots and stores the slots in SLOTS[].  The
+   slots are consecutive if swap has a long enough run of free
+   slots, so that the pages are written with one request and can
+   later be read back together.  Otherwise, the pages are split
+   into smaller runs.  Each slot starts out with one reference.
+   Returns true if successful, false if swap is full, in which
+   case some of the pages may have been written anyway. */
+bool
+swap_out_multi (void *const kpages[], size_t cnt, size_t slots[])
+{
+  size_t slot, i;
+
+  lock_acquire (&swap_lock);
+  slot = bitmap_scan_and_flip (used_slots, 0, cnt, false);
+  if (slot != BITMAP_ERROR)
+    for (i = 0; i < cnt; i++)
+      ref_cnts[slot + i] = 1;
+  lock_release (&swap_lock);
+
+  if (slot == BITMAP_ERROR)
+    {
+      size_t half = cnt / 2;
+      return (cnt > 1
+              && swap_out_multi (kpages, half, slots)
+              && swap_out_multi (kpages + half, cnt - half, slots + half));
+    }
+
+  transfer (slot, kpages, cnt, true);
+  for (i = 0; i < cnt; i++)
+    {
+      slots[i] = slot + i;
+      exception_count (PAGING_SWAP_OUT);
+    }
+  return true;
+}
+
+/* Reads swap slot SLOT into the page at KPAGE and drops a
+   reference to the slot. */
+void
+swap_in (size_t slot, void *kpage)
+{
+  swap_read (slot, &kpage, 1);
+  swap_free (slot);
+}
+
+/* Reads the CNT consecutive swap slots starting at SLOT, at most
+   SWAP_CLUSTER of them, into the pages at KPAGES[] with a single
+   request.  Unlike swap_in(), keeps the references to the slots,
+   which the caller must drop with swap_free() once it no longer
+   needs them. */
+void
+swap_read (size_t slot, void *const kpages[], size_t cnt)
+{
+  size_t i;
+
+  transfer (slot, kpages, cnt, false);
+  for (i = 0; i < cnt; i++)
+    exception_count (PAGING_SWAP_IN);
+}
+
+/* Adds a reference to swap slot SLOT, for a page that shares
+   its contents with the pages already referring to it. */
+void
+swap_dup (size_t slot)
+{
+  lock_acquire (&swap_lock);
+  ASSERT (bitmap_test (used_slots, slot));
+  ASSERT (ref_cnts[slot] < UINT16_MAX);
+  ref_cnts[slot]++;
+  lock_release (&swap_lock);
+}
+
+/* Drops a reference to swap slot SLOT without reading it, and
+   frees the slot if that was the last one. */
+void
+swap_free (size_t slot)
+{
+  lock_acquire (&swap_lock);
+  ASSERT (bitmap_test (used_slots, slot));
+  if (--ref_cnts[slot] == 0)
+    bitmap_reset (used_slots, slot);
+  lock_release (&swap_lock);
+}
@@ -0,0 +1,22 @@
+#ifndef VM_SWAP_H
+#define VM_SWAP_H
+
+#include <bitmap.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+/* Returned by swap_out() when swap is full. */
+#define SWAP_ERROR BITMAP_ERROR
+
+/* Maximum number of pages transferred to or from swap at once. */
+#define SWAP_CLUSTER 8
+
+void swap_init (void);
+size_t swap_out (const void *kpage);
+bool swap_out_multi (void *const kpages[], size_t cnt, size_t slots[]);
+void swap_in (size_t slot, void *kpage);
+void swap_read (size_t slot, void *const kpages[], size_t cnt);
+void swap_dup (size_t slot);
+void swap_free (size_t slot);
+
+#endif /* vm/swap.h */